@@ -0,0 +1,81 @@
+#include "AttackMap.h"
+
+static const uint64_t FILE_A = 0x0101010101010101ULL;
+static const uint64_t FILE_H = 0x8080808080808080ULL;
+
+AttackMap::AttackMap(const chess::Board& board) {
+    chess::Bitboard occupied = board.occ();
+
+    for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
+        int c = int(color);
+        this->pieceCount[c] = 0;
+        this->all[c] = chess::Bitboard(0);
+        this->doubled[c] = chess::Bitboard(0);
+        for (int pt = 0; pt < 6; pt++) this->byType[c][pt] = chess::Bitboard(0);
+
+        uint64_t pawns = board.pieces(chess::PieceType::PAWN, color).getBits();
+        if (color == chess::Color::WHITE) {
+            this->pawnWest[c] = chess::Bitboard((pawns & ~FILE_A) << 7);
+            this->pawnEast[c] = chess::Bitboard((pawns & ~FILE_H) << 9);
+        }
+        else {
+            this->pawnWest[c] = chess::Bitboard((pawns & ~FILE_A) >> 9);
+            this->pawnEast[c] = chess::Bitboard((pawns & ~FILE_H) >> 7);
+        }
+        this->doubled[c] = this->pawnWest[c] & this->pawnEast[c];
+        this->all[c] = this->pawnWest[c] | this->pawnEast[c];
+        this->byType[c][int(chess::PieceType(chess::PieceType::PAWN))] = this->all[c];
+
+        for (chess::PieceType type : {chess::PieceType::KNIGHT, chess::PieceType::BISHOP, chess::PieceType::ROOK, chess::PieceType::QUEEN, chess::PieceType::KING}) {
+            chess::Bitboard bitboard = board.pieces(type, color);
+            while (bitboard) {
+                uint8_t sqIndex = bitboard.pop();
+                chess::Square square = chess::Square(sqIndex);
+                chess::Bitboard attacks;
+                if (type == chess::PieceType::KNIGHT) attacks = chess::attacks::knight(square);
+                else if (type == chess::PieceType::BISHOP) attacks = chess::attacks::bishop(square, occupied);
+                else if (type == chess::PieceType::ROOK) attacks = chess::attacks::rook(square, occupied);
+                else if (type == chess::PieceType::QUEEN) attacks = chess::attacks::queen(square, occupied);
+                else attacks = chess::attacks::king(square);
+
+                this->pieces[c][this->pieceCount[c]++] = PieceAttacks{ type, sqIndex, attacks };
+                this->byType[c][int(type)] |= attacks;
+                this->addAttacks(c, attacks);
+            }
+        }
+
+        chess::Square kingSquare = board.kingSq(color);
+        this->kingZone[c] = chess::attacks::king(kingSquare) | chess::Bitboard(1ULL << kingSquare.index());
+        this->pinned[c] = findPinned(board, color);
+    }
+}
+
+void AttackMap::addAttacks(int color, chess::Bitboard attacks) {
+    this->doubled[color] |= this->all[color] & attacks;
+    this->all[color] |= attacks;
+}
+
+chess::Bitboard AttackMap::findPinned(const chess::Board& board, chess::Color color) {
+    chess::Square kingSquare = board.kingSq(color);
+    chess::Bitboard kingBitboard = chess::Bitboard(1ULL << kingSquare.index());
+    chess::Bitboard ours = board.us(color);
+    chess::Bitboard occupied = board.occ();
+    chess::Bitboard theirQueens = board.pieces(chess::PieceType::QUEEN, ~color);
+    chess::Bitboard pinned = chess::Bitboard(0);
+
+    //Look from the king through our own pieces: any enemy slider on those rays with exactly one piece
+    //in between, and that piece ours, pins it.
+    auto findAlong = [&](chess::Bitboard snipers, auto attackFunc) {
+        while (snipers) {
+            chess::Square sniper = chess::Square(snipers.pop());
+            chess::Bitboard between = attackFunc(kingSquare, chess::Bitboard(1ULL << sniper.index()))
+                & attackFunc(sniper, kingBitboard);
+            chess::Bitboard blockers = between & occupied;
+            if (blockers.count() == 1 && (blockers & ours)) pinned |= blockers;
+        }
+    };
+    chess::Bitboard theirs = board.us(~color);
+    findAlong(chess::attacks::rook(kingSquare, theirs) & (board.pieces(chess::PieceType::ROOK, ~color) | theirQueens), chess::attacks::rook);
+    findAlong(chess::attacks::bishop(kingSquare, theirs) & (board.pieces(chess::PieceType::BISHOP, ~color) | theirQueens), chess::attacks::bishop);
+    return pinned;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+
+//Attack sets of a single non-pawn piece. Pawns are kept set-wise, see AttackMap::pawnWest/pawnEast.
+struct PieceAttacks {
+    chess::PieceType type;
+    uint8_t square;
+    chess::Bitboard attacks;
+};
+
+//Everything the evaluation wants to know about who attacks what, built once per evaluated position.
+//Attack sets include squares occupied by the attacker's own pieces (defended squares), the same as
+//chess::attacks::attackers sees them.
+struct AttackMap {
+    AttackMap(const chess::Board& board);
+
+    //a side never has more than 16 pieces, pawns included, so 16 non-pawn slots always fit
+    PieceAttacks pieces[2][16];
+    int pieceCount[2];
+
+    //One set per capture direction. A pawn attacks at most one square per direction, so summing the
+    //popcounts of the two sets counts every pawn attack exactly once.
+    chess::Bitboard pawnWest[2];
+    chess::Bitboard pawnEast[2];
+
+    chess::Bitboard byType[2][6]; //union of the attacks of every piece of a type
+    chess::Bitboard all[2];       //attacked at least once
+    chess::Bitboard doubled[2];   //attacked at least twice
+    chess::Bitboard kingZone[2];  //the king's square and every square next to it
+    chess::Bitboard pinned[2];    //own pieces that can't leave the line between their king and an enemy slider
+
+private:
+    void addAttacks(int color, chess::Bitboard attacks);
+    static chess::Bitboard findPinned(const chess::Board& board, chess::Color color);
+};
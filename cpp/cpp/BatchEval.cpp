@@ -0,0 +1,210 @@
+#include "BatchEval.h"
+#include "SquareWeights.h"
+#include "ChessEngine.h" //clampEvaluation
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const uint64_t NOT_FILE_A = ~0x0101010101010101ULL;
+static const uint64_t NOT_FILE_H = ~0x8080808080808080ULL;
+static const uint64_t NOT_FILE_AB = ~0x0303030303030303ULL;
+static const uint64_t NOT_FILE_GH = ~0xc0c0c0c0c0c0c0c0ULL;
+static const uint64_t ALL_SQUARES = ~0ULL;
+
+//One bitboard (or one count) per position in the group. The kernels below are written once against these
+//operations; the AVX2 build runs them over four positions per instruction. SSE2 has no byte shuffle or 64-bit
+//compare to count bits with, so anything without AVX2 takes one position at a time with the hardware popcount.
+#if defined(__AVX2__)
+const int LANE_COUNT = 4;
+
+struct Lanes {
+    __m256i v;
+};
+
+static inline Lanes load(const uint64_t* from) { return { _mm256_load_si256((const __m256i*)from) }; }
+static inline void store(uint64_t* to, Lanes a) { _mm256_store_si256((__m256i*)to, a.v); }
+static inline Lanes broadcast(uint64_t value) { return { _mm256_set1_epi64x(int64_t(value)) }; }
+static inline Lanes operator&(Lanes a, Lanes b) { return { _mm256_and_si256(a.v, b.v) }; }
+static inline Lanes operator|(Lanes a, Lanes b) { return { _mm256_or_si256(a.v, b.v) }; }
+static inline Lanes operator~(Lanes a) { return { _mm256_xor_si256(a.v, _mm256_set1_epi64x(-1)) }; }
+static inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_epi64(a.v, b.v) }; }
+static inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_epi64(a.v, b.v) }; }
+
+//positive shifts go up the board, negative ones down
+template <int N>
+static inline Lanes shift(Lanes a) {
+    if constexpr (N >= 0) return { _mm256_slli_epi64(a.v, N) };
+    else return { _mm256_srli_epi64(a.v, -N) };
+}
+
+//each lane shifted left by the count in the same lane of counts
+static inline Lanes shiftBy(Lanes a, Lanes counts) { return { _mm256_sllv_epi64(a.v, counts.v) }; }
+
+//bit counts per nibble from a 16-entry table, then the bytes of each lane summed by their distance from zero
+static inline Lanes popcount(Lanes a) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(a.v, lowNibbles));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(a.v, 4), lowNibbles));
+    return { _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()) };
+}
+
+//1 in every lane that has any bit set, 0 elsewhere
+static inline Lanes nonZero(Lanes a) {
+    return { _mm256_andnot_si256(_mm256_cmpeq_epi64(a.v, _mm256_setzero_si256()), _mm256_set1_epi64x(1)) };
+}
+#else
+const int LANE_COUNT = 1;
+
+struct Lanes {
+    uint64_t v;
+};
+
+static inline Lanes load(const uint64_t* from) { return { *from }; }
+static inline void store(uint64_t* to, Lanes a) { *to = a.v; }
+static inline Lanes broadcast(uint64_t value) { return { value }; }
+static inline Lanes operator&(Lanes a, Lanes b) { return { a.v & b.v }; }
+static inline Lanes operator|(Lanes a, Lanes b) { return { a.v | b.v }; }
+static inline Lanes operator~(Lanes a) { return { ~a.v }; }
+static inline Lanes operator+(Lanes a, Lanes b) { return { a.v + b.v }; }
+static inline Lanes operator-(Lanes a, Lanes b) { return { a.v - b.v }; }
+
+template <int N>
+static inline Lanes shift(Lanes a) {
+    if constexpr (N >= 0) return { a.v << N };
+    else return { a.v >> -N };
+}
+
+static inline Lanes shiftBy(Lanes a, Lanes counts) { return { a.v << counts.v }; }
+static inline Lanes popcount(Lanes a) { return { uint64_t(chess::Bitboard(a.v).count()) }; }
+static inline Lanes nonZero(Lanes a) { return { uint64_t(a.v != 0) }; }
+#endif
+
+static_assert(EVAL_BATCH_SIZE % LANE_COUNT == 0, "a batch is a whole number of lane groups");
+
+static inline Lanes operator&(Lanes a, uint64_t mask) { return a & broadcast(mask); }
+
+//weighSquares from SquareWeights.h, per lane
+static inline Lanes weighSquares(Lanes attacks) {
+    Lanes count = popcount(attacks);
+    return count + count + popcount(attacks & EXTENDED_CENTER) + popcount(attacks & CENTER);
+}
+
+//A piece attacks at most one square per step direction, so the step sets of all pieces of a kind never count a
+//square twice for one piece, and the sum over directions is the sum over pieces the way AttackMap lists them.
+template <int N>
+static inline Lanes stepControl(Lanes pieces, uint64_t edge) {
+    return weighSquares(shift<N>(pieces) & edge);
+}
+
+//Kogge-Stone occluded fill in one direction, then one more step for the squares the rays end on (the first
+//blocker, whoever it belongs to). edge clears the squares a step would wrap onto. The rays of two sliders on one
+//line never overlap in one direction: the one behind stops on the one in front, whose own ray starts past it.
+//So the summed weight of the union is again the sum over pieces.
+template <int N>
+static inline Lanes slideControl(Lanes sliders, Lanes empty, uint64_t edge) {
+    empty = empty & edge;
+    sliders = sliders | (empty & shift<N>(sliders));
+    empty = empty & shift<N>(empty);
+    sliders = sliders | (empty & shift<2 * N>(sliders));
+    empty = empty & shift<2 * N>(empty);
+    sliders = sliders | (empty & shift<4 * N>(sliders));
+    return weighSquares(shift<N>(sliders) & edge);
+}
+
+static Lanes countControl(Lanes pawns, bool white, Lanes knights, Lanes diagonal, Lanes straight, Lanes kings, Lanes empty) {
+    Lanes control = white
+        ? weighSquares(shift<7>(pawns & NOT_FILE_A)) + weighSquares(shift<9>(pawns & NOT_FILE_H))
+        : weighSquares(shift<-9>(pawns & NOT_FILE_A)) + weighSquares(shift<-7>(pawns & NOT_FILE_H));
+
+    control = control + stepControl<17>(knights, NOT_FILE_A) + stepControl<15>(knights, NOT_FILE_H)
+        + stepControl<10>(knights, NOT_FILE_AB) + stepControl<6>(knights, NOT_FILE_GH)
+        + stepControl<-6>(knights, NOT_FILE_AB) + stepControl<-10>(knights, NOT_FILE_GH)
+        + stepControl<-15>(knights, NOT_FILE_A) + stepControl<-17>(knights, NOT_FILE_H);
+
+    control = control + stepControl<8>(kings, ALL_SQUARES) + stepControl<-8>(kings, ALL_SQUARES)
+        + stepControl<1>(kings, NOT_FILE_A) + stepControl<-1>(kings, NOT_FILE_H)
+        + stepControl<9>(kings, NOT_FILE_A) + stepControl<7>(kings, NOT_FILE_H)
+        + stepControl<-7>(kings, NOT_FILE_A) + stepControl<-9>(kings, NOT_FILE_H);
+
+    control = control + slideControl<8>(straight, empty, ALL_SQUARES) + slideControl<-8>(straight, empty, ALL_SQUARES)
+        + slideControl<1>(straight, empty, NOT_FILE_A) + slideControl<-1>(straight, empty, NOT_FILE_H);
+    control = control + slideControl<9>(diagonal, empty, NOT_FILE_A) + slideControl<7>(diagonal, empty, NOT_FILE_H)
+        + slideControl<-7>(diagonal, empty, NOT_FILE_A) + slideControl<-9>(diagonal, empty, NOT_FILE_H);
+    return control;
+}
+
+//longestChains from PawnHashTable.cpp, per lane. Both diagonals only ever lose pawns, so the longer of the two
+//chains is the number of steps that leave anything on either.
+static Lanes longestChain(Lanes pawns) {
+    Lanes up = pawns, down = pawns, length = broadcast(0);
+    for (int step = 0; step < 6; step++) {
+        length = length + nonZero(up | down);
+        up = up & shift<9>(up) & NOT_FILE_A;
+        down = down & shift<7>(down) & NOT_FILE_H;
+    }
+    return length;
+}
+
+static Lanes countMaterial(const uint64_t (&pieces)[6][EVAL_BATCH_SIZE], int at) {
+    Lanes pawns = popcount(load(&pieces[int(chess::PieceType(chess::PieceType::PAWN))][at]));
+    Lanes minors = popcount(load(&pieces[int(chess::PieceType(chess::PieceType::KNIGHT))][at]) | load(&pieces[int(chess::PieceType(chess::PieceType::BISHOP))][at]));
+    Lanes rooks = popcount(load(&pieces[int(chess::PieceType(chess::PieceType::ROOK))][at]));
+    Lanes queens = popcount(load(&pieces[int(chess::PieceType(chess::PieceType::QUEEN))][at]));
+    //1, 3, 5 and 9 out of shifts and adds, AVX2 has no 64-bit multiply
+    return pawns + minors + minors + minors + shift<2>(rooks) + rooks + shift<3>(queens) + queens;
+}
+
+bool BoardBatch::add(const chess::Board& board) {
+    if (this->count == EVAL_BATCH_SIZE) return false;
+    for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
+        for (chess::PieceType type : {chess::PieceType::PAWN, chess::PieceType::KNIGHT, chess::PieceType::BISHOP, chess::PieceType::ROOK, chess::PieceType::QUEEN, chess::PieceType::KING}) {
+            this->pieces[int(color)][int(type)][this->count] = board.pieces(type, color).getBits();
+        }
+    }
+    this->count++;
+    return true;
+}
+
+void evaluateBatch(const BoardBatch& batch, int16_t* scores) {
+    const int pawn = int(chess::PieceType(chess::PieceType::PAWN)), knight = int(chess::PieceType(chess::PieceType::KNIGHT));
+    const int bishop = int(chess::PieceType(chess::PieceType::BISHOP)), rook = int(chess::PieceType(chess::PieceType::ROOK));
+    const int queen = int(chess::PieceType(chess::PieceType::QUEEN)), king = int(chess::PieceType(chess::PieceType::KING));
+    alignas(32) uint64_t results[LANE_COUNT];
+
+    for (int at = 0; at < batch.count; at += LANE_COUNT) {
+        Lanes occupied = broadcast(0);
+        for (int color = 0; color < 2; color++) {
+            for (int type = 0; type < 6; type++) occupied = occupied | load(&batch.pieces[color][type][at]);
+        }
+        Lanes empty = ~occupied;
+
+        Lanes control[2], chain[2];
+        for (int color = 0; color < 2; color++) {
+            const uint64_t (&pieces)[6][EVAL_BATCH_SIZE] = batch.pieces[color];
+            Lanes queens = load(&pieces[queen][at]);
+            chain[color] = longestChain(load(&pieces[pawn][at]));
+            control[color] = countControl(load(&pieces[pawn][at]), color == 0, load(&pieces[knight][at]),
+                load(&pieces[bishop][at]) | queens, load(&pieces[rook][at]) | queens, load(&pieces[king][at]), empty);
+        }
+
+        Lanes material = countMaterial(batch.pieces[0], at) - countMaterial(batch.pieces[1], at);
+        Lanes pawnScore = shiftBy(broadcast(2), chain[0]) - shiftBy(broadcast(2), chain[1]);
+        store(results, shift<8>(material) + control[0] - control[1] + pawnScore);
+
+        //the lanes are two's complement 64-bit sums, clamped the same as staticEvaluate's
+        for (int lane = 0; lane < LANE_COUNT && at + lane < batch.count; lane++) {
+            scores[at + lane] = clampEvaluation(int64_t(results[lane]));
+        }
+    }
+}
+
+void evaluateBatch(const chess::PackedBoard* boards, size_t count, int16_t* scores) {
+    BoardBatch batch;
+    for (size_t start = 0; start < count; start += EVAL_BATCH_SIZE) {
+        batch.clear();
+        for (size_t i = start; i < count && batch.add(chess::Board::Compact::decode(boards[i])); i++) {}
+        evaluateBatch(batch, scores + start);
+    }
+}
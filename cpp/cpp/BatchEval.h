@@ -0,0 +1,25 @@
+#pragma once
+#include "chess.hpp"
+#include <cstddef>
+#include <cstdint>
+
+const int EVAL_BATCH_SIZE = 64; //positions unpacked at a time, a multiple of every lane width
+
+//Positions side by side, structure of arrays: the bitboard of one piece kind is contiguous across positions,
+//so the same bitboard of several positions loads straight into vector lanes. Slots past count are never read
+//into a score.
+struct BoardBatch {
+    alignas(32) uint64_t pieces[2][6][EVAL_BATCH_SIZE] = {}; //[color][PieceType][position]
+    int count = 0;
+
+    void clear() { this->count = 0; }
+    bool add(const chess::Board& board); //false when the batch is full
+};
+
+//The classical static evaluation (material, positional control and pawn chains, white's point of view, 256 per
+//pawn) of many positions at once, without the search's noise, game-end checks or bitbases. Every term is worked
+//out set-wise across positions, four to an AVX2 register or one at a time without AVX2, and agrees with
+//ChessEngine's per-position terms. Meant for throughput work: ordering a batch of children, labelling datasets
+//and tuning.
+void evaluateBatch(const BoardBatch& batch, int16_t* scores);
+void evaluateBatch(const chess::PackedBoard* boards, size_t count, int16_t* scores); //decodes EVAL_BATCH_SIZE at a time
@@ -0,0 +1,207 @@
+#include "Bitbase.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+
+enum BitbaseState : uint8_t {
+    BITBASE_UNKNOWN,
+    BITBASE_INVALID,
+    BITBASE_DRAW,
+    BITBASE_WIN
+};
+
+static size_t bitbaseIndex(bool weakToMove, int strongKing, int weakKing, int piece) {
+    return ((size_t(weakToMove) * 64 + strongKing) * 64 + weakKing) * 64 + piece;
+}
+
+static bool readBit(const unsigned char* bits, size_t index) {
+    return (bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static uint64_t kingAttacks(int square) {
+    return chess::attacks::king(chess::Square(square)).getBits();
+}
+
+//the strong side is white here, so a pawn attacks and moves up the board
+static uint64_t pieceAttacks(BitbaseMaterial material, int square, uint64_t occupied) {
+    if (material == BITBASE_KQK) return chess::attacks::queen(chess::Square(square), chess::Bitboard(occupied)).getBits();
+    if (material == BITBASE_KRK) return chess::attacks::rook(chess::Square(square), chess::Bitboard(occupied)).getBits();
+    return chess::attacks::pawn(chess::Color::WHITE, chess::Square(square)).getBits();
+}
+
+//splits [0, BITBASE_POSITIONS) into one contiguous range per thread
+static void parallelFor(int threads, const std::function<void(size_t, size_t)>& work) {
+    std::vector<std::thread> workers;
+    size_t chunk = (BITBASE_POSITIONS + threads - 1) / threads;
+    for (int i = 0; i < threads; i++) {
+        size_t begin = std::min(BITBASE_POSITIONS, i * chunk);
+        size_t end = std::min(BITBASE_POSITIONS, begin + chunk);
+        workers.emplace_back(work, begin, end);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool Bitbase::open(const std::string& directory) {
+    bool any = false;
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        if (this->tables[i].open(directory + "/" + BITBASE_NAMES[i] + ".bitbase") && this->tables[i].getSize() != BITBASE_BYTES) {
+            this->tables[i].close();
+        }
+        any |= this->tables[i].isOpen();
+    }
+    return any;
+}
+
+void Bitbase::close() {
+    for (MappedFile& table : this->tables) {
+        table.close();
+    }
+}
+
+bool Bitbase::probe(const chess::Board& board, int& result) const {
+    if (board.occ().count() != 3) return false;
+    chess::Color strong = board.us(chess::Color::WHITE).count() == 2 ? chess::Color::WHITE : chess::Color::BLACK;
+    chess::Bitboard piece = board.us(strong) & ~board.pieces(chess::PieceType::KING);
+
+    BitbaseMaterial material;
+    if (piece & board.pieces(chess::PieceType::QUEEN)) material = BITBASE_KQK;
+    else if (piece & board.pieces(chess::PieceType::ROOK)) material = BITBASE_KRK;
+    else if (piece & board.pieces(chess::PieceType::PAWN)) material = BITBASE_KPK;
+    else return false; //a lone minor piece is insufficient material, the board already knows that
+    if (!this->tables[material].isOpen()) return false;
+
+    //black as the strong side is the same position mirrored top to bottom
+    int flip = strong == chess::Color::WHITE ? 0 : 56;
+    size_t index = bitbaseIndex(board.sideToMove() != strong, board.kingSq(strong).index() ^ flip, board.kingSq(~strong).index() ^ flip, piece.lsb() ^ flip);
+    bool win = readBit(this->tables[material].getData(), index);
+    result = !win ? 0 : strong == chess::Color::WHITE ? 1 : -1;
+    return true;
+}
+
+bool Bitbase::generate(const std::string& directory, int threads) {
+    std::vector<uint8_t> generated[BITBASE_COUNT];
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        generated[i] = generateTable(BitbaseMaterial(i), std::max(threads, 1), generated);
+        std::ofstream file(directory + "/" + BITBASE_NAMES[i] + ".bitbase", std::ios::binary);
+        file.write(reinterpret_cast<const char*>(generated[i].data()), generated[i].size());
+        if (!file) return false;
+    }
+    return true;
+}
+
+//Retrograde analysis by repeated passes. Mates, stalemates and captures of the piece are settled first; after
+//that a position with the strong side to move is a win as soon as one move reaches a win, and a position with
+//the bare king to move is a win once every move does. Each pass settles what the last one made decidable,
+//split over the threads, until a pass changes nothing; whatever is still open then can never be forced, so
+//it is a draw. A pass reads states other threads may be writing, but a state only ever goes from unknown
+//to settled, so reading an old one just leaves that position for the next pass.
+std::vector<uint8_t> Bitbase::generateTable(BitbaseMaterial material, int threads, const std::vector<uint8_t>* generated) {
+    std::unique_ptr<std::atomic<uint8_t>[]> states(new std::atomic<uint8_t>[BITBASE_POSITIONS]);
+
+    auto resolve = [&](size_t index) -> uint8_t {
+        int piece = index & 63;
+        int weakKing = (index >> 6) & 63;
+        int strongKing = (index >> 12) & 63;
+        bool weakToMove = index >> 18;
+        uint64_t strongKingBit = 1ULL << strongKing, weakKingBit = 1ULL << weakKing, pieceBit = 1ULL << piece;
+
+        if (weakToMove) {
+            //the weak king is left out of the occupancy, it can't hide behind itself from a slider
+            uint64_t attacked = kingAttacks(strongKing) | pieceAttacks(material, piece, strongKingBit | pieceBit);
+            uint64_t targets = kingAttacks(weakKing) & ~attacked;
+            if (!targets) return (attacked & weakKingBit) ? BITBASE_WIN : BITBASE_DRAW;
+            if (targets & pieceBit) return BITBASE_DRAW; //takes the piece
+            bool allWin = true;
+            while (targets) {
+                int target = chess::Bitboard(targets).lsb();
+                targets &= targets - 1;
+                uint8_t state = states[bitbaseIndex(false, strongKing, target, piece)].load(std::memory_order_relaxed);
+                if (state == BITBASE_DRAW) return BITBASE_DRAW;
+                if (state != BITBASE_WIN) allWin = false;
+            }
+            return allWin ? BITBASE_WIN : BITBASE_UNKNOWN;
+        }
+
+        //children of a strong move: (weak king to move, strong king, piece) after it
+        uint64_t occupied = strongKingBit | weakKingBit | pieceBit;
+        bool allDraw = true;
+        auto child = [&](int newStrongKing, int newPiece) {
+            uint8_t state = states[bitbaseIndex(true, newStrongKing, weakKing, newPiece)].load(std::memory_order_relaxed);
+            if (state != BITBASE_DRAW) allDraw = false;
+            return state == BITBASE_WIN;
+        };
+
+        uint64_t kingTargets = kingAttacks(strongKing) & ~kingAttacks(weakKing) & ~pieceBit;
+        while (kingTargets) {
+            int target = chess::Bitboard(kingTargets).lsb();
+            kingTargets &= kingTargets - 1;
+            if (child(target, piece)) return BITBASE_WIN;
+        }
+
+        if (material == BITBASE_KPK) {
+            int push = piece + 8;
+            if (!(occupied & (1ULL << push))) {
+                if (push >= 56) {
+                    //promotes into a table that is already finished, underpromotions to a minor piece only draw
+                    size_t promoted = bitbaseIndex(true, strongKing, weakKing, push);
+                    if (readBit(generated[BITBASE_KQK].data(), promoted) || readBit(generated[BITBASE_KRK].data(), promoted)) return BITBASE_WIN;
+                }
+                else {
+                    if (child(strongKing, push)) return BITBASE_WIN;
+                    if (piece < 16 && !(occupied & (1ULL << (push + 8))) && child(strongKing, push + 8)) return BITBASE_WIN;
+                }
+            }
+        }
+        else {
+            uint64_t pieceTargets = pieceAttacks(material, piece, occupied) & ~occupied;
+            while (pieceTargets) {
+                int target = chess::Bitboard(pieceTargets).lsb();
+                pieceTargets &= pieceTargets - 1;
+                if (child(strongKing, target)) return BITBASE_WIN;
+            }
+        }
+        return allDraw ? BITBASE_DRAW : BITBASE_UNKNOWN;
+    };
+
+    //illegal positions never come up as a child, so they can be left out of every pass
+    parallelFor(threads, [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; index++) {
+            int piece = index & 63;
+            int weakKing = (index >> 6) & 63;
+            int strongKing = (index >> 12) & 63;
+            bool weakToMove = index >> 18;
+            bool invalid = piece == strongKing || piece == weakKing || strongKing == weakKing
+                || (kingAttacks(strongKing) & (1ULL << weakKing))
+                || (material == BITBASE_KPK && (piece < 8 || piece >= 56))
+                || (!weakToMove && (pieceAttacks(material, piece, (1ULL << strongKing) | (1ULL << piece)) & (1ULL << weakKing)));
+            states[index].store(invalid ? BITBASE_INVALID : BITBASE_UNKNOWN, std::memory_order_relaxed);
+        }
+    });
+
+    std::atomic<bool> changed{true};
+    while (changed) {
+        changed = false;
+        parallelFor(threads, [&](size_t begin, size_t end) {
+            bool changedHere = false;
+            for (size_t index = begin; index < end; index++) {
+                if (states[index].load(std::memory_order_relaxed) != BITBASE_UNKNOWN) continue;
+                uint8_t state = resolve(index);
+                if (state == BITBASE_UNKNOWN) continue;
+                states[index].store(state, std::memory_order_relaxed);
+                changedHere = true;
+            }
+            if (changedHere) changed = true;
+        });
+    }
+
+    std::vector<uint8_t> table(BITBASE_BYTES, 0);
+    for (size_t index = 0; index < BITBASE_POSITIONS; index++) {
+        if (states[index].load(std::memory_order_relaxed) == BITBASE_WIN) table[index >> 3] |= uint8_t(1 << (index & 7));
+    }
+    return table;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "chess.hpp"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//king and one piece against a bare king, the strong side is always the one with the piece
+enum BitbaseMaterial {
+    BITBASE_KQK,
+    BITBASE_KRK,
+    BITBASE_KPK, //after KQK and KRK, a promotion is looked up in them
+    BITBASE_COUNT
+};
+
+const char* const BITBASE_NAMES[BITBASE_COUNT] = { "KQK", "KRK", "KPK" };
+const size_t BITBASE_POSITIONS = 2 * 64 * 64 * 64; //[strong side to move?][strong king][weak king][piece]
+const size_t BITBASE_BYTES = BITBASE_POSITIONS / 8;
+
+//Win/draw bitbases for the three-piece endings that aren't already insufficient material. One bit per
+//position says whether the strong side wins; a bare king never wins, so that is the whole win/draw/loss
+//answer. Positions are seen from the strong side as white, so a table covers both colours. 64 KB per table.
+//
+//Tables are made by generate (see bitbase_gen.cpp) and memory-mapped by open, so a probe is one bit read and
+//any number of engines and processes share the same pages.
+class Bitbase {
+    public:
+        bool open(const std::string& directory); //maps every <name>.bitbase there, false if none could be
+        void close();
+        //true if the position is covered, result is then +1 white wins, 0 draw, -1 black wins
+        bool probe(const chess::Board& board, int& result) const;
+        static bool generate(const std::string& directory, int threads);
+
+        //getters and setters
+        bool isOpen(BitbaseMaterial material) const { return this->tables[material].isOpen(); }
+    private:
+        static std::vector<uint8_t> generateTable(BitbaseMaterial material, int threads, const std::vector<uint8_t>* generated);
+
+        MappedFile tables[BITBASE_COUNT];
+};
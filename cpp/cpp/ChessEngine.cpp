@@ -1,15 +1,55 @@
 #include "ChessEngine.h"
+#include "SquareWeights.h"
+#include <sstream>
 
-ChessEngine::ChessEngine(chess::Board* board, int depth, int beamWidth) {
+ChessEngine::ChessEngine(chess::Board* board, int depth, int beamWidth, int threads, int hashSizeMB) : transpositionTable(hashSizeMB) {
     this->depth = depth;
     this->beamWidth = beamWidth;
     this->currentState = board;
     this->debug = false;
     std::random_device rd;
     this->gen = std::mt19937(rd());
+    this->noiseSeed = (uint64_t(this->gen()) << 32) | this->gen();
+    this->evalNoise = NOISE_HASHED;
+    this->stopSearch = false;
+    this->nodes = 0;
+    this->evalType = CLASSICAL_EVAL;
+    this->statsLogger = nullptr;
+    this->book = nullptr;
+    this->bookSelection = BOOK_WEIGHTED;
+    this->bitbase = nullptr;
+    this->pondering = false;
+    this->afterBestMoveHash = 0;
+    this->multiPv = 1;
+    this->depthLimit = MAX_DEPTH;
+    this->deadline = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+    this->budgetStart = 0;
+    this->nodeLimit = 0;
+    this->externalStop = nullptr;
+
+    for (int i = 0; i < std::max(threads, 1); i++) {
+        std::unique_ptr<SearchThread> thread = std::make_unique<SearchThread>();
+        thread->id = i;
+        thread->depth = depth;
+        thread->nodes = 0;
+        thread->completedDepth = 0;
+        std::fill(&thread->history[0][0][0], &thread->history[0][0][0] + 2 * 64 * 64, int16_t(0));
+        thread->accumulators.resize(MAX_DEPTH + 2);
+        thread->accumulatorIndex = 0;
+        this->searchThreads.push_back(std::move(thread));
+    }
 }
 
 ChessEngine::~ChessEngine() {
+    this->stopPondering();
+}
+
+//The seed picks which noise every position gets and which book moves are played. A single-threaded search
+//from the same seed repeats node for node, which is what bench needs to compare runs; a new seed per game
+//keeps games from repeating each other.
+void ChessEngine::setSeed(uint32_t seed) {
+    this->gen = std::mt19937(seed);
+    this->noiseSeed = (uint64_t(this->gen()) << 32) | this->gen();
 }
 
 void ChessEngine::makeMove(chess::Move move) {
@@ -17,13 +57,371 @@ void ChessEngine::makeMove(chess::Move move) {
 }
 
 chess::Move ChessEngine::getBestMove() {
-    auto toReturn = alphaBetaSearch();
+    SearchLimits limits;
+    limits.depth = this->depth;
+    return this->getBestMove(limits);
+}
+
+chess::Move ChessEngine::getBestMove(std::chrono::milliseconds timeLimit) {
+    SearchLimits limits;
+    limits.deadline = std::chrono::steady_clock::now() + timeLimit;
+    return this->getBestMove(limits);
+}
+
+chess::Move ChessEngine::getBestMove(const SearchLimits& limits) {
+    //a book move is played without searching at all, so there is nothing to ponder on after it either
+    if (this->book != nullptr) {
+        chess::Move bookMove = this->book->probe(*this->currentState, this->bookSelection, this->gen());
+        if (bookMove != chess::Move(chess::Move::NO_MOVE)) {
+            this->stopPondering();
+            this->stats = SearchStats();
+            this->nodes = 0;
+            this->searchThreads[0]->completedDepth = 0;
+            this->principalVariation.clear();
+            this->rootLines.clear();
+            return bookMove;
+        }
+    }
+
+    chess::Move toReturn;
+    if (this->pondering && this->ponderBoard.hash() == this->currentState->hash()) {
+        toReturn = this->ponderHit(limits);
+    }
+    else {
+        this->stopPondering();
+        this->prepareSearch(*this->currentState, limits);
+        toReturn = this->runSearch();
+    }
+
+    if (this->statsLogger != nullptr && toReturn != chess::Move(chess::Move::NO_MOVE)) {
+        this->statsLogger->log(this->stats, chess::uci::moveToSan(*this->currentState, toReturn), this->currentState->sideToMove());
+    }
+    return toReturn;
+}
+
+//Multi-PV analysis: the best root moves, as many as lines asks for, ranked and each with its score and
+//line, from one search (see iterativeDeepening). The engine's own MultiPV setting is left as it was. Empty
+//after a book move.
+std::vector<RootLine> ChessEngine::getBestMoves(int lines, const SearchLimits& limits) {
+    int multiPv = this->multiPv;
+    this->setMultiPv(lines);
+    this->getBestMove(limits);
+    this->multiPv = multiPv;
+    return this->rootLines;
+}
+
+//Pondering: once the engine's move has been played, search the position after the reply the last search
+//expected while the opponent thinks, with no limit but stopPondering. If the opponent does play it,
+//getBestMove takes over that search where it is instead of starting a new one. Returns false if the last
+//search left no expected reply, or the board isn't the one its move led to.
+bool ChessEngine::startPondering() {
+    this->stopPondering();
+    if (this->principalVariation.size() < 2 || this->currentState->hash() != this->afterBestMoveHash) return false;
+    this->ponderBoard = *this->currentState;
+    this->ponderMove = this->principalVariation[1];
+    if (!isLegalMove(this->ponderMove, &this->ponderBoard)) return false;
+    this->ponderBoard.makeMove(this->ponderMove);
+
+    //set up here rather than on the new thread, so a ponder hit can never be overwritten by the setup
+    this->prepareSearch(this->ponderBoard, SearchLimits());
+    this->pondering = true;
+    this->ponderThread = std::thread([this]() {
+        this->ponderResult = this->runSearch();
+    });
+    return true;
+}
+
+//A ponder miss: the search is for a position that won't happen, so it is dropped without waiting for anything
+void ChessEngine::stopPondering() {
+    if (!this->pondering) return;
+    this->stopSearch = true;
+    this->ponderThread.join();
+    this->pondering = false;
+}
+
+//A ponder hit: the running search gets the caller's limits. Time and nodes count from the hit, so the search
+//answers as soon as a cold one would, with the pondering on top of that budget; the depth counts from the
+//root, and a search already that deep stops straight away with what it has.
+chess::Move ChessEngine::ponderHit(const SearchLimits& limits) {
+    int depth = limits.depth <= 0 || limits.depth > MAX_DEPTH ? MAX_DEPTH : limits.depth;
+    this->depthLimit = depth;
+    this->budgetStart = std::chrono::steady_clock::now().time_since_epoch().count();
+    this->deadline = limits.deadline.time_since_epoch().count();
+    this->nodeLimit = limits.nodes == 0 ? 0 : this->countAllNodes() + limits.nodes;
+    this->externalStop = limits.stop;
+    //the depth is read between iterations, an iteration deeper than needed is cut short here
+    if (this->searchThreads[0]->completedDepth >= depth || (limits.stop != nullptr && limits.stop->load())) {
+        this->stopSearch = true;
+    }
+
+    this->ponderThread.join();
+    this->pondering = false;
+    return this->ponderResult;
+}
+
+void ChessEngine::prepareSearch(const chess::Board& root, const SearchLimits& limits) {
+    this->transpositionTable.newSearch();
+    this->stopSearch = false;
+    this->depthLimit = limits.depth <= 0 || limits.depth > MAX_DEPTH ? MAX_DEPTH : limits.depth;
+    this->deadline = limits.deadline.time_since_epoch().count();
+    this->nodeLimit = limits.nodes;
+    this->externalStop = limits.stop;
+    this->searchStart = std::chrono::steady_clock::now();
+    this->budgetStart = this->searchStart.time_since_epoch().count();
+
+    for (std::unique_ptr<SearchThread>& thread : this->searchThreads) {
+        thread->board = root;
+        thread->nodes = 0;
+        thread->bestMove = chess::Move(chess::Move::NO_MOVE);
+        thread->bestScore = 0;
+        thread->rootHashMove = chess::Move(chess::Move::NO_MOVE);
+        thread->excludedRootMoves.clear();
+        thread->rootLines.clear();
+        thread->completedDepth = 0;
+        thread->accumulatorIndex = 0;
+        thread->pawnKey = PawnHashTable::pawnKey(thread->board);
+        thread->counters.clear();
+        if (this->evalType == NNUE_EVAL) this->network.refresh(thread->board, thread->accumulators[0]);
+        for (auto& killers : thread->killers) {
+            killers[0] = killers[1] = chess::Move(chess::Move::NO_MOVE);
+        }
+        //history from the last move is still mostly right, just less sure
+        for (auto& byColor : thread->history) {
+            for (auto& byFrom : byColor) {
+                for (int16_t& entry : byFrom) entry /= 2;
+            }
+        }
+    }
+}
+
+chess::Move ChessEngine::runSearch() {
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < this->searchThreads.size(); i++) {
+        SearchThread* helper = this->searchThreads[i].get();
+        helpers.emplace_back([this, helper]() { this->iterativeDeepening(helper); });
+    }
+
+    //only the main thread's answer is used; once it has one the helpers are told to give up
+    chess::Move toReturn = iterativeDeepening(this->searchThreads[0].get());
+    this->stopSearch = true;
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+
+    this->nodes = 0;
+    this->stats = SearchStats();
+    for (std::unique_ptr<SearchThread>& thread : this->searchThreads) {
+        this->nodes += thread->nodes;
+        this->stats.add(thread->counters);
+    }
+    SearchThread* mainThread = this->searchThreads[0].get();
+    this->stats.depth = mainThread->completedDepth;
+    this->stats.nodes = this->nodes;
+    this->stats.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->searchStart).count();
+    this->stats.bestScore = mainThread->bestScore;
+    this->stats.minScore = std::min(mainThread->counters.rootMinScore, mainThread->bestScore);
+    this->stats.maxScore = std::max(mainThread->counters.rootMaxScore, mainThread->bestScore);
+    this->rootLines = mainThread->rootLines;
+    this->principalVariation = this->rootLines.empty() ? this->extractPrincipalVariation(mainThread, mainThread->bestMove) : this->rootLines[0].pv;
+    if (!this->principalVariation.empty()) {
+        chess::Board afterBestMove = mainThread->board;
+        afterBestMove.makeMove(this->principalVariation[0]);
+        this->afterBestMoveHash = afterBestMove.hash();
+    }
+    return toReturn;
+}
+
+chess::Move ChessEngine::iterativeDeepening(SearchThread* thread) {
+    //Lazy SMP: every thread searches the same root on its own board. Odd helpers stay one ply ahead of the
+    //main thread, so they order and cut moves differently and fill the shared table with results the main
+    //thread has not reached yet. Every thread sees the same noise, so whatever they share agrees.
+    int depthOffset = thread->id % 2;
+    //helpers only feed the table, one line is all they need
+    int lineCount = thread->id == 0 ? std::min(this->multiPv, std::max(int(calculateLegalMoves(&thread->board).size()), 1)) : 1;
+
+    //both limits are re-read every iteration, a ponder hit can change them mid-search
+    for (int iterationDepth = 1; iterationDepth <= this->depthLimit.load(std::memory_order_relaxed); iterationDepth++) {
+        thread->depth = std::min(iterationDepth + depthOffset, MAX_DEPTH);
+
+        //Multi-PV: every line searches the root again without the moves the lines before it found, so the
+        //k-th line is the k-th best move. The table, killers and history the first line filled are all there
+        //for the rest, which mostly re-read what it already searched, so K lines cost far less than K searches.
+        std::vector<RootLine> lines;
+        bool firstLineDone = false;
+        Score firstScore = 0;
+        for (int line = 0; line < lineCount; line++) {
+            bool seen = line < int(thread->rootLines.size());
+            thread->rootHashMove = line == 0 ? thread->bestMove : seen ? thread->rootLines[line].move : chess::Move(chess::Move::NO_MOVE);
+            Score score = this->aspirationSearch(thread, line == 0 ? thread->bestScore : seen ? thread->rootLines[line].score : SCORE_INFINITE);
+            //A stop inside a re-search throws away even a move that failed high: it only has a bound and no line,
+            //and the move played has to be the one rootLines, the PV and the pondering start all agree on.
+            if (this->stopSearch.load(std::memory_order_relaxed)) break;
+            if (line == 0) {
+                firstLineDone = true;
+                firstScore = score;
+            }
+            if (thread->rootMove == chess::Move(chess::Move::NO_MOVE)) break; //mated or stalemated, no line to show
+            lines.push_back(RootLine{ thread->rootMove, score, thread->depth, this->extractPrincipalVariation(thread, thread->rootMove) });
+            thread->excludedRootMoves.add(thread->rootMove);
+        }
+        thread->excludedRootMoves.clear();
+        this->rankRootLines(thread, lines, lineCount);
+        if (firstLineDone) {
+            thread->bestMove = thread->rootLines.empty() ? chess::Move(chess::Move::NO_MOVE) : thread->rootLines[0].move;
+            thread->bestScore = thread->rootLines.empty() ? firstScore : thread->rootLines[0].score;
+        }
+
+        //an iteration interrupted before its first line finished only looked at some of the root moves, so its
+        //answer is thrown away; lines it did finish are kept, at this iteration's depth
+        if (this->stopSearch.load(std::memory_order_relaxed)) {
+            if (thread->bestMove == chess::Move(chess::Move::NO_MOVE)) thread->bestMove = thread->rootMove;
+            break;
+        }
+        thread->completedDepth = thread->depth;
+
+        if (this->debug && thread->id == 0) {
+            std::cout << "depth " << thread->depth << " best " << chess::uci::moveToUci(thread->bestMove) << " score " << thread->bestScore << std::endl;
+        }
+        if (this->infoCallback && thread->id == 0) {
+            uint64_t nodes = this->countAllNodes();
+            std::chrono::milliseconds time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->searchStart);
+            //a root with no moves still reports its score, with no line
+            for (int line = 0; line < std::max(int(thread->rootLines.size()), 1); line++) {
+                bool hasLine = line < int(thread->rootLines.size());
+                SearchInfo info;
+                info.multiPv = line + 1;
+                info.depth = thread->depth;
+                info.score = hasLine ? thread->rootLines[line].score : thread->bestScore;
+                info.nodes = nodes;
+                info.time = time;
+                if (hasLine) info.pv = thread->rootLines[line].pv;
+                this->infoCallback(info);
+            }
+        }
+
+        //each iteration costs several times the one before, so past half the budget the next one won't finish
+        std::chrono::steady_clock::time_point deadline = this->getDeadline();
+        std::chrono::steady_clock::time_point budgetStart(std::chrono::steady_clock::duration(this->budgetStart.load(std::memory_order_relaxed)));
+        bool hasDeadline = deadline != std::chrono::steady_clock::time_point::max();
+        if (thread->id == 0 && hasDeadline && std::chrono::steady_clock::now() - budgetStart > (deadline - budgetStart) / 2) {
+            break;
+        }
+    }
+
+    //stopped before even the first iteration finished a root move: any legal move beats none
+    if (thread->bestMove == chess::Move(chess::Move::NO_MOVE)) {
+        chess::Movelist legalMoves = calculateLegalMoves(&thread->board);
+        if (!legalMoves.empty()) thread->bestMove = legalMoves[0];
+    }
+    //the move carries its score the way getBestMove always handed it out, as an int16_t with mates at +-0x7fff
+    chess::Move toReturn = thread->bestMove;
+    toReturn.setScore(int16_t(std::clamp(thread->bestScore, Score(-0x7fff), Score(0x7fff))));
     return toReturn;
 }
 
+//The lines this iteration finished come first, best first for the side to move; a stop can leave lines
+//unfinished, and those keep their place from the last iteration after them.
+void ChessEngine::rankRootLines(SearchThread* thread, std::vector<RootLine>& lines, int lineCount) {
+    bool white = thread->board.sideToMove() == chess::Color::WHITE;
+    std::stable_sort(lines.begin(), lines.end(), [white](const RootLine& a, const RootLine& b) {
+        return white ? a.score > b.score : a.score < b.score;
+    });
+    for (const RootLine& older : thread->rootLines) {
+        if (int(lines.size()) >= lineCount) break;
+        bool found = std::any_of(lines.begin(), lines.end(), [&](const RootLine& line) { return line.move == older.move; });
+        if (!found) lines.push_back(older);
+    }
+    thread->rootLines = std::move(lines);
+}
+
+//One search of the root at thread->depth. From ASPIRATION_MIN_DEPTH it looks at a narrow window around
+//previous, the line's score last iteration, which cuts far more; SCORE_INFINITE searches the full window.
+//A score outside the window is only a bound, so that side is widened, twice as far each time, and the root
+//searched again. Mates are not worth guessing at.
+Score ChessEngine::aspirationSearch(SearchThread* thread, Score previous) {
+    Score delta = ASPIRATION_WINDOW;
+    Score alpha = -SCORE_INFINITE, beta = SCORE_INFINITE;
+    if (thread->depth >= ASPIRATION_MIN_DEPTH && std::abs(previous) < SCORE_MATE_BOUND) {
+        alpha = std::max(previous - delta, -SCORE_INFINITE);
+        beta = std::min(previous + delta, SCORE_INFINITE);
+    }
+    while (true) {
+        thread->rootMove = chess::Move(chess::Move::NO_MOVE);
+        Score score = alphaBetaSearch(thread, alpha, beta);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return score;
+        if (score <= alpha && alpha > -SCORE_INFINITE) {
+            alpha = std::max(score - delta, -SCORE_INFINITE);
+        }
+        else if (score >= beta && beta < SCORE_INFINITE) {
+            beta = std::min(score + delta, SCORE_INFINITE);
+            //a move that beat beta is at least as good as last iteration's, try it first again
+            thread->rootHashMove = thread->rootMove;
+        }
+        else {
+            return score;
+        }
+        thread->counters.aspirationResearches++;
+        delta *= 2;
+    }
+}
+
+void ChessEngine::countNode(SearchThread* thread) {
+    uint64_t nodes = thread->nodes.load(std::memory_order_relaxed) + 1;
+    thread->nodes.store(nodes, std::memory_order_relaxed);
+
+    //reading the clock every node would cost more than the node, so only the main thread looks, every 1024 nodes
+    if (thread->id == 0 && (nodes & 1023) == 0) {
+        this->checkLimits();
+    }
+}
+
+void ChessEngine::checkLimits() {
+    if (std::chrono::steady_clock::now() >= this->getDeadline()) {
+        this->stopSearch = true;
+        return;
+    }
+    const std::atomic<bool>* stop = this->externalStop.load(std::memory_order_relaxed);
+    if (stop != nullptr && stop->load(std::memory_order_relaxed)) {
+        this->stopSearch = true;
+        return;
+    }
+    uint64_t nodeLimit = this->nodeLimit.load(std::memory_order_relaxed);
+    if (nodeLimit != 0 && this->countAllNodes() >= nodeLimit) {
+        this->stopSearch = true;
+    }
+}
+
+uint64_t ChessEngine::countAllNodes() {
+    uint64_t totalNodes = 0;
+    for (std::unique_ptr<SearchThread>& thread : this->searchThreads) {
+        totalNodes += thread->nodes.load(std::memory_order_relaxed);
+    }
+    return totalNodes;
+}
+
+//The table keeps the best move of every node it saw, so the line the search expects is a root move followed
+//by the stored move of each position after it. Entries can be overwritten or belong to a colliding position,
+//so every move is checked for legality, and the walk stops at a repetition so it can't loop.
+std::vector<chess::Move> ChessEngine::extractPrincipalVariation(SearchThread* thread, chess::Move first) {
+    std::vector<chess::Move> pv;
+    chess::Board board = thread->board;
+    chess::Move move = first;
+    while (move != chess::Move(chess::Move::NO_MOVE) && int(pv.size()) < thread->depth && isLegalMove(move, &board)) {
+        pv.push_back(move);
+        board.makeMove(move);
+        if (board.isRepetition(1)) break;
+
+        TTEntry entry;
+        move = this->transpositionTable.probe(board.hash(), entry) ? chess::Move(entry.move) : chess::Move(chess::Move::NO_MOVE);
+    }
+    return pv;
+}
+
+//Static evaluation of any position, for callers outside the search such as GameTree. Borrows the main
+//search thread's pawn table and counters, so it must not be called while a search is running.
 int16_t ChessEngine::evaluate(chess::Board* position) {
     if (position == nullptr) position = this->currentState;
-    return 0;
+    return constantTimeEvaluate(this->searchThreads[0].get(), position);
 }
 
 bool ChessEngine::isLegalMove(chess::Move move, chess::Board* position) {
@@ -32,6 +430,42 @@ bool ChessEngine::isLegalMove(chess::Move move, chess::Board* position) {
     return std::find(legalMoves.begin(), legalMoves.end(), move) != legalMoves.end();
 }
 
+//Whether a FEN from outside (a file, a client) is well formed enough to build a board from; chess::Board
+//trusts what it is given. The placement field must be eight ranks of eight files of piece letters and digits,
+//and the side to move, castling rights, en passant square and move counters right where they are given. Says
+//nothing about whether the position could come up in a game.
+bool ChessEngine::isValidFen(const std::string& fen) {
+    std::istringstream fields(fen);
+    std::vector<std::string> parts;
+    std::string part;
+    while (fields >> part) parts.push_back(part);
+    if (parts.size() < 2 || parts.size() > 6) return false;
+
+    int ranks = 1, files = 0;
+    for (char c : parts[0]) {
+        if (c == '/') {
+            if (files != 8) return false;
+            ranks++;
+            files = 0;
+        }
+        else if (c >= '1' && c <= '8') files += c - '0';
+        else if (std::string("pnbrqkPNBRQK").find(c) != std::string::npos) files++;
+        else return false;
+        if (files > 8) return false;
+    }
+    if (ranks != 8 || files != 8) return false;
+
+    if (parts[1] != "w" && parts[1] != "b") return false;
+    if (parts.size() > 2 && parts[2] != "-" && parts[2].find_first_not_of("KQkqABCDEFGHabcdefgh") != std::string::npos) return false;
+    if (parts.size() > 3 && parts[3] != "-" && (parts[3].size() != 2 || parts[3][0] < 'a' || parts[3][0] > 'h' || (parts[3][1] != '3' && parts[3][1] != '6'))) {
+        return false;
+    }
+    for (size_t i = 4; i < parts.size(); i++) {
+        if (parts[i].size() > 6 || parts[i].find_first_not_of("0123456789") != std::string::npos) return false;
+    }
+    return true;
+}
+
 chess::Movelist ChessEngine::calculateLegalMoves(chess::Board* position) {
     if (position == nullptr) position = this->currentState;
     chess::Movelist toReturn;
@@ -39,9 +473,10 @@ chess::Movelist ChessEngine::calculateLegalMoves(chess::Board* position) {
     return toReturn;
 }
 
-int16_t ChessEngine::constantTimeEvaluate(chess::Board* position, chess::Movelist* legalMoves ) {
+int16_t ChessEngine::constantTimeEvaluate(SearchThread* thread, chess::Board* position, chess::Movelist* legalMoves ) {
+    chess::Movelist moves;
     if (legalMoves == nullptr) {
-        chess::Movelist moves = calculateLegalMoves(position);
+        moves = calculateLegalMoves(position);
         legalMoves = &moves;
     }
     switch (getGameState(position, legalMoves)) {
@@ -55,115 +490,532 @@ int16_t ChessEngine::constantTimeEvaluate(chess::Board* position, chess::Movelis
         return 0x7fff;
     }
 
-    int16_t result = (countMaterial(position) << 8) + (countPositionalControl(position)) + (countPawnStructure(position)) + std::uniform_int_distribution<int>(-5, 5)(this->gen);
-    return result;
+    int16_t knownScore;
+    if (this->probeBitbase(thread, position, knownScore)) return knownScore;
+    return staticEvaluate(thread, position);
+}
+
+int16_t ChessEngine::staticEvaluate(SearchThread* thread, chess::Board* position) {
+    thread->counters.leafEvals++;
+    int16_t noise = this->evalNoiseFor(position);
+    if (this->evalType == NNUE_EVAL) {
+        //the search keeps the thread's own board in step with its accumulator stack, any other board starts over
+        if (position == &thread->board) {
+            return clampEvaluation(this->network.evaluate(thread->accumulators[thread->accumulatorIndex], position->sideToMove()) + noise);
+        }
+        NnueAccumulator accumulator;
+        this->network.refresh(*position, accumulator);
+        return clampEvaluation(this->network.evaluate(accumulator, position->sideToMove()) + noise);
+    }
+
+    AttackMap attackMap(*position);
+    int result = (countMaterial(position) << 8) + (countPositionalControl(attackMap)) + (this->probePawns(thread, position)->score) + noise;
+    return clampEvaluation(result);
+}
+
+//Noise keeps otherwise equal moves from always going the same way, but it is hashed from the position rather
+//than drawn: a position scores the same every time it is reached, on every thread, so evaluations can be
+//cached and searches repeat. The game's seed goes into the hash so different games still differ.
+int16_t ChessEngine::evalNoiseFor(chess::Board* position) {
+    if (this->evalNoise == NOISE_OFF) return 0;
+    //splitmix64 finaliser, positions a move apart get unrelated noise
+    uint64_t z = position->hash() ^ this->noiseSeed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return int16_t(z % (2 * EVAL_NOISE + 1)) - EVAL_NOISE;
 }
 
-chess::Move ChessEngine::alphaBetaSearch() {
-    if (this->currentState->sideToMove() == chess::Color::WHITE) {
-        return this->bestMoveForWhite(this->currentState);
+void ChessEngine::makeSearchMove(SearchThread* thread, chess::Move move) {
+    if (this->evalType == NNUE_EVAL) {
+        //the delta has to be read off the board before the move changes it
+        NnueDelta delta = NnueNetwork::moveDelta(thread->board, move);
+        this->network.update(thread->accumulators[thread->accumulatorIndex], thread->accumulators[thread->accumulatorIndex + 1], delta);
+        thread->accumulatorIndex++;
     }
-    return this->bestMoveForBlack(this->currentState);
+    thread->pawnKey ^= PawnHashTable::pawnKeyDelta(thread->board, move);
+    thread->board.makeMove(move);
+}
+
+void ChessEngine::unmakeSearchMove(SearchThread* thread, chess::Move move) {
+    thread->board.unmakeMove(move);
+    thread->pawnKey ^= PawnHashTable::pawnKeyDelta(thread->board, move); //the same delta, read off the same board
+    //the parent's accumulator is still on the stack untouched, so undoing a move is just a pop
+    if (this->evalType == NNUE_EVAL) thread->accumulatorIndex--;
+}
+
+bool ChessEngine::loadNetwork(const std::string& path) {
+    return this->network.load(path);
+}
+
+bool ChessEngine::setEvalType(EvalType evalType) {
+    if (evalType == NNUE_EVAL && !this->network.isLoaded()) return false;
+    this->evalType = evalType;
+    return true;
 }
 
-chess::Move ChessEngine::bestMoveForWhite(chess::Board* position, int curDepth, int16_t alpha, int16_t beta) {
-    chess::Movelist legalMoves = calculateLegalMoves(position);
-    chess::Move toReturn = chess::Move();
-    toReturn.setScore(-0x7fff);
-    if (curDepth >= this->depth || getGameState(position, &legalMoves) != STILL_PLAYING) {
-        toReturn.setScore(constantTimeEvaluate(position, &legalMoves));
-        return toReturn;
+Score ChessEngine::alphaBetaSearch(SearchThread* thread, Score alpha, Score beta) {
+    if (thread->board.sideToMove() == chess::Color::WHITE) {
+        return this->bestMoveForWhite(thread, 0, thread->depth, alpha, beta);
     }
+    return this->bestMoveForBlack(thread, 0, thread->depth, alpha, beta);
+}
 
-    position->makeNullMove();
-    int16_t lowerLimit = bestMoveForBlack(position, depth).score();
-    position->unmakeNullMove();
+Score ChessEngine::bestMoveForWhite(SearchThread* thread, int curDepth, int remainingDepth, Score alpha, Score beta, bool allowNullMove) {
+    chess::Board* position = &thread->board;
+    if (remainingDepth <= 0) {
+        return isDrawByRule(position) ? 0 : quiescenceForWhite(thread, curDepth, alpha, beta);
+    }
+    countNode(thread);
+    if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+    Score alphaOrig = alpha;
+    Score betaOrig = beta;
 
-    for (chess::Move& move : legalMoves) {
-        position->makeMove(move);
-        move.setScore(constantTimeEvaluate(position));
-        position->unmakeMove(move);
+    //A deep enough stored result for this position answers the node without generating any moves.
+    //Never cut at the root, which has to come back with a real move.
+    TTEntry entry;
+    chess::Move hashMove = curDepth == 0 ? thread->rootHashMove : chess::Move(chess::Move::NO_MOVE);
+    thread->counters.ttProbes++;
+    if (this->transpositionTable.probe(position->hash(), entry)) {
+        thread->counters.ttHits++;
+        if (curDepth > 0 || hashMove == chess::Move(chess::Move::NO_MOVE)) hashMove = chess::Move(entry.move);
+        Score stored = scoreFromTable(entry.score, curDepth);
+        if (curDepth > 0 && entry.depth >= remainingDepth && (
+            entry.bound() == TT_EXACT ||
+            (entry.bound() == TT_LOWER && stored >= beta) ||
+            (entry.bound() == TT_UPPER && stored <= alpha))) {
+            thread->counters.ttCutoffs++;
+            return stored;
+        }
     }
 
-    std::sort(legalMoves.begin(), legalMoves.end(), std::greater<chess::Move>());
+    if (curDepth > 0 && isDrawByRule(position)) return 0;
+    int16_t knownScore;
+    if (curDepth > 0 && this->probeBitbase(thread, position, knownScore)) return knownScore;
+    Score nullScore;
+    if (allowNullMove && this->tryNullMove(thread, chess::Color::WHITE, curDepth, remainingDepth, alpha, beta, nullScore)) {
+        return nullScore;
+    }
 
-    for (int i = 0; i < std::min(this->beamWidth, legalMoves.size()); i++) {
+    Score best = -SCORE_INFINITE;
+    chess::Move bestMove = chess::Move(chess::Move::NO_MOVE);
+    MovePicker movePicker(position, hashMove, thread->killers[curDepth], thread->history[0]);
+    chess::Movelist quietsTried;
+    bool inCheck = position->inCheck();
+    int moveCount = 0;
+    for (chess::Move move = movePicker.next(); move != chess::Move(chess::Move::NO_MOVE); move = movePicker.next()) {
+        bool quiet = !position->isCapture(move) && move.typeOf() != chess::Move::PROMOTION;
+        bool late = quiet && !inCheck && movePicker.getStage() == PICK_QUIETS; //not the hash move or a killer
+        if (curDepth == 0 && std::find(thread->excludedRootMoves.begin(), thread->excludedRootMoves.end(), move) != thread->excludedRootMoves.end()) {
+            continue;
+        }
+        if (late && curDepth > 0 && best > -BITBASE_WIN_SCORE && this->isLateMovePruned(remainingDepth, moveCount)) {
+            thread->counters.lateMovePrunes++;
+            continue;
+        }
+        moveCount++;
         if (this->debug) {
             for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Looking at " << chess::uci::moveToSan(*position, legalMoves[i]) << std::endl;
+            std::cout << "Looking at " << chess::uci::moveToSan(*position, move) << std::endl;
         }
 
-        if (legalMoves[i].score() < lowerLimit) continue;
-
-        position->makeMove(legalMoves[i]);
-        legalMoves[i].setScore(bestMoveForBlack(position, curDepth + 1, alpha, beta).score());
-        position->unmakeMove(legalMoves[i]);
+        makeSearchMove(thread, move);
+        Score score;
+        if (moveCount == 1) {
+            score = bestMoveForBlack(thread, curDepth + 1, remainingDepth - 1, alpha, beta);
+        }
+        else {
+            //Principal variation search: every move after the first only has to show it can't beat alpha,
+            //which a zero window proves far more cheaply. Late quiet moves are asked at a reduced depth first.
+            //Whatever does beat alpha is searched again, at full depth and then with the full window.
+            int reduction = late && !position->inCheck() ? this->lateMoveReduction(remainingDepth, moveCount) : 0;
+            if (reduction > 0) thread->counters.lmrReductions++;
+            score = bestMoveForBlack(thread, curDepth + 1, remainingDepth - 1 - reduction, alpha, alpha + 1);
+            if (score > alpha && reduction > 0) {
+                thread->counters.researches++;
+                score = bestMoveForBlack(thread, curDepth + 1, remainingDepth - 1, alpha, alpha + 1);
+            }
+            if (score > alpha && score < beta) {
+                thread->counters.researches++;
+                score = bestMoveForBlack(thread, curDepth + 1, remainingDepth - 1, alpha, beta);
+            }
+        }
+        unmakeSearchMove(thread, move);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return best;
 
         if (this->debug) {
             for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << " score: " << legalMoves[i].score() << std::endl;
+            std::cout << " score: " << score << std::endl;
+        }
+        if (score > best) {
+            best = score;
+            bestMove = move;
+            if (curDepth == 0) thread->rootMove = move;
         }
-        toReturn = toReturn > legalMoves[i] ? toReturn : legalMoves[i];
+        if (curDepth == 0) thread->counters.addRootScore(score);
 
-        if (legalMoves[i].score() >= beta) {
+        if (score >= beta) {
+            thread->counters.addCutoff(moveCount - 1, true);
+            if (quiet) updateQuietHistory(thread, chess::Color::WHITE, curDepth, remainingDepth, move, &quietsTried);
             break;
         }
-        alpha = std::max(alpha, legalMoves[i].score());
+        if (quiet) quietsTried.add(move);
+        alpha = std::max(alpha, score);
+    }
+
+    //nothing to play: mated, the sooner the worse, or stalemated
+    if (moveCount == 0) {
+        return position->inCheck() ? -(SCORE_MATE - curDepth) : 0;
     }
+
     if (this->debug) {
         for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-        std::cout << "Picked move: " << chess::uci::moveToSan(*position, toReturn) << std::endl;
+        std::cout << "Picked move: " << chess::uci::moveToSan(*position, bestMove) << std::endl;
     }
-    return toReturn;
+
+    //a root searched without some of its moves has no true score to store
+    if (curDepth == 0 && !thread->excludedRootMoves.empty()) return best;
+    TTBound bound = best >= betaOrig ? TT_LOWER : best <= alphaOrig ? TT_UPPER : TT_EXACT;
+    this->transpositionTable.store(position->hash(), remainingDepth, bound, scoreToTable(best, curDepth), bestMove);
+    return best;
 }
 
-chess::Move ChessEngine::bestMoveForBlack(chess::Board* position, int curDepth, int16_t alpha, int16_t beta) {
-    chess::Movelist legalMoves = calculateLegalMoves(position);
-    chess::Move toReturn = chess::Move();
-    toReturn.setScore(0x7fff);
-    if (curDepth >= this->depth || getGameState(position, &legalMoves) != STILL_PLAYING) {
-        toReturn.setScore(constantTimeEvaluate(position, &legalMoves));
-        return toReturn;
+Score ChessEngine::bestMoveForBlack(SearchThread* thread, int curDepth, int remainingDepth, Score alpha, Score beta, bool allowNullMove) {
+    chess::Board* position = &thread->board;
+    if (remainingDepth <= 0) {
+        return isDrawByRule(position) ? 0 : quiescenceForBlack(thread, curDepth, alpha, beta);
     }
+    countNode(thread);
+    if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+    Score alphaOrig = alpha;
+    Score betaOrig = beta;
 
-    position->makeNullMove();
-    int16_t upperLimit = bestMoveForWhite(position, depth).score();
-    position->unmakeNullMove();
-
-    for (chess::Move& move : legalMoves) {
-        position->makeMove(move);
-        move.setScore(constantTimeEvaluate(position));
-        position->unmakeMove(move);
+    //A deep enough stored result for this position answers the node without generating any moves.
+    //Never cut at the root, which has to come back with a real move.
+    TTEntry entry;
+    chess::Move hashMove = curDepth == 0 ? thread->rootHashMove : chess::Move(chess::Move::NO_MOVE);
+    thread->counters.ttProbes++;
+    if (this->transpositionTable.probe(position->hash(), entry)) {
+        thread->counters.ttHits++;
+        if (curDepth > 0 || hashMove == chess::Move(chess::Move::NO_MOVE)) hashMove = chess::Move(entry.move);
+        Score stored = scoreFromTable(entry.score, curDepth);
+        if (curDepth > 0 && entry.depth >= remainingDepth && (
+            entry.bound() == TT_EXACT ||
+            (entry.bound() == TT_LOWER && stored >= beta) ||
+            (entry.bound() == TT_UPPER && stored <= alpha))) {
+            thread->counters.ttCutoffs++;
+            return stored;
+        }
     }
 
-    std::sort(legalMoves.begin(), legalMoves.end());
+    if (curDepth > 0 && isDrawByRule(position)) return 0;
+    int16_t knownScore;
+    if (curDepth > 0 && this->probeBitbase(thread, position, knownScore)) return knownScore;
+    Score nullScore;
+    if (allowNullMove && this->tryNullMove(thread, chess::Color::BLACK, curDepth, remainingDepth, alpha, beta, nullScore)) {
+        return nullScore;
+    }
 
-    for (int i = 0; i < std::min(this->beamWidth, legalMoves.size()); i++) {
+    Score best = SCORE_INFINITE;
+    chess::Move bestMove = chess::Move(chess::Move::NO_MOVE);
+    MovePicker movePicker(position, hashMove, thread->killers[curDepth], thread->history[1]);
+    chess::Movelist quietsTried;
+    bool inCheck = position->inCheck();
+    int moveCount = 0;
+    for (chess::Move move = movePicker.next(); move != chess::Move(chess::Move::NO_MOVE); move = movePicker.next()) {
+        bool quiet = !position->isCapture(move) && move.typeOf() != chess::Move::PROMOTION;
+        bool late = quiet && !inCheck && movePicker.getStage() == PICK_QUIETS;
+        if (curDepth == 0 && std::find(thread->excludedRootMoves.begin(), thread->excludedRootMoves.end(), move) != thread->excludedRootMoves.end()) {
+            continue;
+        }
+        if (late && curDepth > 0 && best < BITBASE_WIN_SCORE && this->isLateMovePruned(remainingDepth, moveCount)) {
+            thread->counters.lateMovePrunes++;
+            continue;
+        }
+        moveCount++;
         if (this->debug) {
             for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Looking at " << chess::uci::moveToSan(*position, legalMoves[i]) << std::endl;
+            std::cout << "Looking at " << chess::uci::moveToSan(*position, move) << std::endl;
         }
-        if (legalMoves[i].score() > upperLimit) continue;
-        position->makeMove(legalMoves[i]);
-        legalMoves[i].setScore(bestMoveForWhite(position, curDepth + 1, alpha, beta).score());
-        position->unmakeMove(legalMoves[i]);
+
+        makeSearchMove(thread, move);
+        Score score;
+        if (moveCount == 1) {
+            score = bestMoveForWhite(thread, curDepth + 1, remainingDepth - 1, alpha, beta);
+        }
+        else {
+            int reduction = late && !position->inCheck() ? this->lateMoveReduction(remainingDepth, moveCount) : 0;
+            if (reduction > 0) thread->counters.lmrReductions++;
+            score = bestMoveForWhite(thread, curDepth + 1, remainingDepth - 1 - reduction, beta - 1, beta);
+            if (score < beta && reduction > 0) {
+                thread->counters.researches++;
+                score = bestMoveForWhite(thread, curDepth + 1, remainingDepth - 1, beta - 1, beta);
+            }
+            if (score < beta && score > alpha) {
+                thread->counters.researches++;
+                score = bestMoveForWhite(thread, curDepth + 1, remainingDepth - 1, alpha, beta);
+            }
+        }
+        unmakeSearchMove(thread, move);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return best;
 
         if (this->debug) {
             for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << " score: " << legalMoves[i].score() << std::endl;
+            std::cout << " score: " << score << std::endl;
+        }
+        if (score < best) {
+            best = score;
+            bestMove = move;
+            if (curDepth == 0) thread->rootMove = move;
         }
-        toReturn = toReturn < legalMoves[i] ? toReturn : legalMoves[i];
+        if (curDepth == 0) thread->counters.addRootScore(score);
 
-        if (legalMoves[i].score() <= alpha) {
+        if (score <= alpha) {
+            thread->counters.addCutoff(moveCount - 1, false);
+            if (quiet) updateQuietHistory(thread, chess::Color::BLACK, curDepth, remainingDepth, move, &quietsTried);
             break;
         }
+        if (quiet) quietsTried.add(move);
         if (this->debug) {
             for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Picked move: " << chess::uci::moveToSan(*position, toReturn) << std::endl;
+            std::cout << "Picked move: " << chess::uci::moveToSan(*position, bestMove) << std::endl;
         }
-        beta = std::min(beta, legalMoves[i].score());
+        beta = std::min(beta, score);
     }
-    return toReturn;
+
+    //nothing to play: mated, the sooner the worse, or stalemated
+    if (moveCount == 0) {
+        return position->inCheck() ? SCORE_MATE - curDepth : 0;
+    }
+
+    if (curDepth == 0 && !thread->excludedRootMoves.empty()) return best;
+    TTBound bound = best <= alphaOrig ? TT_UPPER : best >= betaOrig ? TT_LOWER : TT_EXACT;
+    this->transpositionTable.store(position->hash(), remainingDepth, bound, scoreToTable(best, curDepth), bestMove);
+    return best;
+}
+
+//Late-move pruning: this close to the horizon, a quiet move this far down the ordering almost never turns
+//out best, so the rest are skipped. beamWidth moves are searched one ply from the horizon and more the
+//further away it is; captures, killers, the hash move and evasions are never skipped.
+bool ChessEngine::isLateMovePruned(int remainingDepth, int moveCount) {
+    return remainingDepth <= LATE_MOVE_PRUNING_DEPTH && moveCount >= this->beamWidth + remainingDepth * remainingDepth;
+}
+
+//Late move reductions grow with the log of both the depth left and the move's place in the ordering. The
+//first few moves and the last two plies are never reduced, and a reduced search always keeps one ply.
+int ChessEngine::lateMoveReduction(int remainingDepth, int moveCount) {
+    static const auto table = [] {
+        std::array<std::array<int8_t, LMR_TABLE_MOVES>, MAX_DEPTH + 1> reductions = {};
+        for (int depth = 1; depth <= MAX_DEPTH; depth++) {
+            for (int moves = 1; moves < LMR_TABLE_MOVES; moves++) {
+                reductions[depth][moves] = int8_t(0.75 + std::log(depth) * std::log(moves) / 2.25);
+            }
+        }
+        return reductions;
+    }();
+    if (remainingDepth < LMR_MIN_DEPTH || moveCount <= LMR_FULL_DEPTH_MOVES) return 0;
+    int reduction = table[std::min(remainingDepth, MAX_DEPTH)][std::min(moveCount, LMR_TABLE_MOVES - 1)];
+    return std::min(reduction, remainingDepth - 2);
+}
+
+//Null move: hand the opponent a free move. If a reduced, zero-window search still finds the score past the
+//bound, no real move would bring it back either, and the whole subtree is cut. Passing is illegal in check,
+//and in zugzwang passing is the best move there is, which endings with only pawns left are full of
+//(king_jail.fen), so neither tries it. R grows with depth and with how far the static evaluation already is
+//past the bound. Deep cutoffs are confirmed by a reduced search of this node with null moves turned off, so a
+//zugzwang the pawn test misses costs a few plies instead of a wrong cutoff.
+bool ChessEngine::tryNullMove(SearchThread* thread, chess::Color color, int curDepth, int remainingDepth, Score alpha, Score beta, Score& score) {
+    chess::Board* position = &thread->board;
+    bool white = color == chess::Color::WHITE;
+    Score bound = white ? beta : alpha;
+    //near a mate or a won ending the bound itself is what is being proven, passing can't help
+    if (curDepth == 0 || remainingDepth < NULL_MOVE_MIN_DEPTH || std::abs(bound) >= BITBASE_WIN_SCORE) return false;
+    if (position->inCheck() || !position->hasNonPawnMaterial(color)) return false;
+    Score staticScore = staticEvaluate(thread, position);
+    Score margin = white ? staticScore - beta : alpha - staticScore;
+    if (margin < 0) return false;
+
+    int reduction = NULL_MOVE_REDUCTION + remainingDepth / 6 + int(std::min<Score>(margin / NULL_MOVE_MARGIN_STEP, 3));
+    thread->counters.nullMoveTries++;
+    position->makeNullMove();
+    Score nullScore = white
+        ? bestMoveForBlack(thread, curDepth + 1, remainingDepth - 1 - reduction, beta - 1, beta, false)
+        : bestMoveForWhite(thread, curDepth + 1, remainingDepth - 1 - reduction, alpha, alpha + 1, false);
+    position->unmakeNullMove();
+    if (this->stopSearch.load(std::memory_order_relaxed)) return false;
+    if (white ? nullScore < beta : nullScore > alpha) return false;
+
+    if (remainingDepth >= NULL_MOVE_VERIFY_DEPTH) {
+        Score verified = white
+            ? bestMoveForWhite(thread, curDepth, remainingDepth - reduction, beta - 1, beta, false)
+            : bestMoveForBlack(thread, curDepth, remainingDepth - reduction, alpha, alpha + 1, false);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return false;
+        if (white ? verified < beta : verified > alpha) return false;
+    }
+    thread->counters.nullMoveCutoffs++;
+    //a mate found after passing is not one anybody can force, only the bound is proven
+    score = std::abs(nullScore) >= BITBASE_WIN_SCORE ? bound : nullScore;
+    return true;
+}
+
+//Past the nominal depth, keep resolving captures until the position is quiet so the leaf score doesn't
+//hinge on a piece that is hanging right now. The side to move may always stand pat on the static
+//evaluation instead of capturing, except in check, where every evasion is searched and no evasion is mate.
+Score ChessEngine::quiescenceForWhite(SearchThread* thread, int ply, Score alpha, Score beta) {
+    chess::Board* position = &thread->board;
+    countNode(thread);
+    thread->counters.quiescenceNodes++;
+    if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+    if (position->isInsufficientMaterial()) return 0;
+    int16_t knownScore;
+    if (this->probeBitbase(thread, position, knownScore)) return knownScore;
+
+    bool inCheck = position->inCheck();
+    Score best = -SCORE_INFINITE;
+    if (!inCheck || ply >= MAX_DEPTH) {
+        best = staticEvaluate(thread, position);
+        if (best >= beta || ply >= MAX_DEPTH) return best;
+        alpha = std::max(alpha, best);
+    }
+
+    MovePicker movePicker = inCheck ? MovePicker(position, chess::Move(chess::Move::NO_MOVE), thread->killers[ply], thread->history[0]) : MovePicker(position);
+    int moveCount = 0;
+    for (chess::Move move = movePicker.next(); move != chess::Move(chess::Move::NO_MOVE); move = movePicker.next()) {
+        moveCount++;
+
+        //delta pruning: if even winning the piece for free plus a margin can't reach alpha, don't bother
+        if (!inCheck && move.typeOf() != chess::Move::PROMOTION
+            && best + (MovePicker::captureValue(position, move) << 8) + QUIESCENCE_DELTA_MARGIN <= alpha) {
+            continue;
+        }
+
+        makeSearchMove(thread, move);
+        Score score = quiescenceForBlack(thread, ply + 1, alpha, beta);
+        unmakeSearchMove(thread, move);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+
+        best = std::max(best, score);
+        if (score >= beta) return score;
+        alpha = std::max(alpha, score);
+    }
+
+    if (inCheck && moveCount == 0) return -(SCORE_MATE - ply);
+    return best;
+}
+
+Score ChessEngine::quiescenceForBlack(SearchThread* thread, int ply, Score alpha, Score beta) {
+    chess::Board* position = &thread->board;
+    countNode(thread);
+    thread->counters.quiescenceNodes++;
+    if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+    if (position->isInsufficientMaterial()) return 0;
+    int16_t knownScore;
+    if (this->probeBitbase(thread, position, knownScore)) return knownScore;
+
+    bool inCheck = position->inCheck();
+    Score best = SCORE_INFINITE;
+    if (!inCheck || ply >= MAX_DEPTH) {
+        best = staticEvaluate(thread, position);
+        if (best <= alpha || ply >= MAX_DEPTH) return best;
+        beta = std::min(beta, best);
+    }
+
+    MovePicker movePicker = inCheck ? MovePicker(position, chess::Move(chess::Move::NO_MOVE), thread->killers[ply], thread->history[1]) : MovePicker(position);
+    int moveCount = 0;
+    for (chess::Move move = movePicker.next(); move != chess::Move(chess::Move::NO_MOVE); move = movePicker.next()) {
+        moveCount++;
+
+        if (!inCheck && move.typeOf() != chess::Move::PROMOTION
+            && best - (MovePicker::captureValue(position, move) << 8) - QUIESCENCE_DELTA_MARGIN >= beta) {
+            continue;
+        }
+
+        makeSearchMove(thread, move);
+        Score score = quiescenceForWhite(thread, ply + 1, alpha, beta);
+        unmakeSearchMove(thread, move);
+        if (this->stopSearch.load(std::memory_order_relaxed)) return 0;
+
+        best = std::min(best, score);
+        if (score <= alpha) return score;
+        beta = std::min(beta, score);
+    }
+
+    if (inCheck && moveCount == 0) return SCORE_MATE - ply;
+    return best;
+}
+
+void ChessEngine::updateQuietHistory(SearchThread* thread, chess::Color color, int curDepth, int remainingDepth, chess::Move move, chess::Movelist* quietsTried) {
+    int bonus = std::min(remainingDepth * remainingDepth, 400);
+
+    if (thread->killers[curDepth][0] != move) {
+        thread->killers[curDepth][1] = thread->killers[curDepth][0];
+        thread->killers[curDepth][0] = move;
+    }
+
+    //Moves that cut off get pushed up, quiet moves tried before them and failed get pushed down. The
+    //update shrinks as a score nears the +-16384 cap, so history can't overflow and old results fade.
+    auto adjust = [&](chess::Move m, int delta) {
+        int16_t& entry = thread->history[int(color)][m.from().index()][m.to().index()];
+        entry = int16_t(entry + delta - entry * std::abs(delta) / 16384);
+    };
+    adjust(move, bonus);
+    for (chess::Move tried : *quietsTried) {
+        adjust(tried, -bonus);
+    }
+}
+
+//The table is shared between plies, so a mate is stored as its distance from the node and turned back into
+//a distance from the root when it is read. GameTree keeps its node scores the same way.
+Score ChessEngine::scoreToTable(Score score, int curDepth) {
+    if (score >= SCORE_MATE_BOUND) return score + curDepth;
+    if (score <= -SCORE_MATE_BOUND) return score - curDepth;
+    return score;
+}
+
+Score ChessEngine::scoreFromTable(Score score, int curDepth) {
+    if (score >= SCORE_MATE_BOUND) return score - curDepth;
+    if (score <= -SCORE_MATE_BOUND) return score + curDepth;
+    return score;
+}
+
+bool ChessEngine::isDrawByRule(chess::Board* position) {
+    return position->isInsufficientMaterial() || position->isRepetition() || position->isHalfMoveDraw();
+}
+
+//A bitbase result answers the node outright. A win is scored under any mate but over any evaluation, plus
+//a little for progress so the search still heads for the mate instead of shuffling between won positions.
+//A won position in check is left to the search: the bitbase can't tell it from mate, the search can.
+bool ChessEngine::probeBitbase(SearchThread* thread, chess::Board* position, int16_t& score) {
+    int result;
+    if (this->bitbase == nullptr || !this->bitbase->probe(*position, result)) return false;
+    if (result != 0 && position->inCheck()) return false;
+    thread->counters.bitbaseHits++;
+    if (result == 0) score = 0;
+    else if (result > 0) score = countKnownWin(position, chess::Color::WHITE);
+    else score = -countKnownWin(position, chess::Color::BLACK);
+    return true;
+}
+
+//A queen wins by more than a rook, a rook by more than a pawn, so a promotion always looks like progress.
+//With a pawn, progress is the pawn's rank; with a piece, the losing king being driven to the edge and the
+//winning king coming up to it.
+int16_t ChessEngine::countKnownWin(chess::Board* position, chess::Color strong) {
+    auto distance = [](int a, int b) { return std::max(std::abs((a & 7) - (b & 7)), std::abs((a >> 3) - (b >> 3))); };
+    int strongKing = position->kingSq(strong).index();
+    int weakKing = position->kingSq(~strong).index();
+    int progress;
+    chess::Bitboard pawns = position->pieces(chess::PieceType::PAWN);
+    if (pawns) {
+        int pawn = pawns.lsb();
+        int rank = strong == chess::Color::WHITE ? pawn >> 3 : 7 - (pawn >> 3);
+        progress = rank * 32 + (7 - distance(strongKing, pawn)) * 4;
+    }
+    else {
+        int file = weakKing & 7, rank = weakKing >> 3;
+        int fromCentre = std::max(3 - file, file - 4) + std::max(3 - rank, rank - 4);
+        progress = fromCentre * 16 + (7 - distance(strongKing, weakKing)) * 8;
+    }
+    return BITBASE_WIN_SCORE + (std::abs(countMaterial(position)) << 8) + progress;
 }
 
 GameState ChessEngine::getGameState(chess::Board* position, chess::Movelist* legalMoves) {
@@ -254,175 +1106,76 @@ int16_t ChessEngine::countRelativeMaterial(chess::Board* position) {
     return (difference << 15) / total; //TODO: maybe a cheaper operation?
 }
 
-int16_t ChessEngine::countPositionalControl(chess::Board* position) {
+//Squares weighed by how central they are, see SquareWeights.h
+int16_t ChessEngine::countPositionalControl(const AttackMap& attackMap) {
     int16_t positionalControl = 0;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            chess::Square square = chess::Square(chess::File(i), chess::Rank(j));
-            int16_t squareValue = ChessEngine::squareValueLookupTable[i][j];
-            chess::Bitboard blackAttackers = chess::attacks::attackers(*position, chess::Color::BLACK, square);
-            positionalControl -= blackAttackers.count() * squareValue;
-            chess::Bitboard whiteAttackers = chess::attacks::attackers(*position, chess::Color::WHITE, square);
-            positionalControl += whiteAttackers.count() * squareValue;
+    for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
+        int c = int(color);
+        int16_t control = weighSquares(attackMap.pawnWest[c]) + weighSquares(attackMap.pawnEast[c]);
+        for (int i = 0; i < attackMap.pieceCount[c]; i++) {
+            control += weighSquares(attackMap.pieces[c][i].attacks);
         }
+        positionalControl += color == chess::Color::WHITE ? control : -control;
     }
     return positionalControl;
 }
 
-int16_t ChessEngine::countPieceMobility(chess::Board* position) {
+int16_t ChessEngine::countPieceMobility(const AttackMap& attackMap) {
     int16_t pieceMobility = 0;
     for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
-
-        chess::Bitboard bitboard = position->pieces(chess::PieceType::PAWN, color);
-
-        while (bitboard) {
-            uint8_t sqIndex = bitboard.pop();
-            if (color == chess::Color::WHITE) {
-                pieceMobility += chess::attacks::pawn(color, chess::Square(sqIndex)).count();
-            }
-            else {
-                pieceMobility -= chess::attacks::pawn(color, chess::Square(sqIndex)).count();
-            }
+        int c = int(color);
+        int16_t mobility = attackMap.pawnWest[c].count() + attackMap.pawnEast[c].count();
+        for (int i = 0; i < attackMap.pieceCount[c]; i++) {
+            mobility += attackMap.pieces[c][i].attacks.count();
         }
-
-        bitboard = position->pieces(chess::PieceType::KNIGHT, color);
-        while (bitboard) {
-            uint8_t sqIndex = bitboard.pop();
-            if (color == chess::Color::WHITE) {
-                pieceMobility += chess::attacks::knight(chess::Square(sqIndex)).count();
-            }
-            else {
-                pieceMobility -= chess::attacks::knight(chess::Square(sqIndex)).count();
-            }
-        }
-
-        chess::Bitboard occupied = position->occ();
-        auto handleSlidingPiece = [&](chess::PieceType type, auto attackFunc) {
-            bitboard = position->pieces(type, color);
-            while (bitboard) {
-                uint8_t sqIndex = bitboard.pop();
-                if (color == chess::Color::WHITE) {
-                    pieceMobility += attackFunc(chess::Square(sqIndex), occupied).count();
-                }
-                else {
-                    pieceMobility -= attackFunc(chess::Square(sqIndex), occupied).count();
-                }
-            }
-        };
-        handleSlidingPiece(chess::PieceType::BISHOP, chess::attacks::bishop);
-        handleSlidingPiece(chess::PieceType::ROOK, chess::attacks::rook);
-        handleSlidingPiece(chess::PieceType::QUEEN, chess::attacks::queen);
+        pieceMobility += color == chess::Color::WHITE ? mobility : -mobility;
     }
     return pieceMobility;
 }
-int16_t ChessEngine::countPawnStructure(chess::Board* position) {
-    chess::Bitboard whitePawns = position->pieces(chess::PieceType::PAWN, chess::Color::WHITE);
-    chess::Bitboard blackPawns = position->pieces(chess::PieceType::PAWN, chess::Color::BLACK);
-
-    //How are we counting pawn structure?
-    //Length of pawn chains: each pawn is part of a chain. I'm thinking we do, for each pawn, score += 1 << std::min(4, pawnChainLength)
-    //Pawn islands: each pawn is part of an island. Get the width of that island. This punishes isolated and doubled pawns. We can do, for each island, score += 1 << min(6, islandWidth).
-
-    //so we wanna do it by file. a, b, c... What's the best way to do it? Bits are ordered as a1, b1, c1, d1, etc...
-    //Create a bitmask for each file. Then, make a file bitboard by ANDing the bitmask with the pawn bitboard. Then, use LSB on that. 
-    int64_t fileA = 0x0101010101010101;
-    int64_t fileB = 0x0202020202020202;
-    int64_t fileC = 0x0404040404040404;
-    int64_t fileD = 0x0808080808080808;
-    int64_t fileE = 0x1010101010101010;
-    int64_t fileF = 0x2020202020202020;
-    int64_t fileG = 0x4040404040404040;
-    int64_t fileH = 0x8080808080808080;
-
-    int64_t fileMasks[8] = {
-        0x0101010101010101,
-        0x0202020202020202,
-        0x0404040404040404,
-        0x0808080808080808,
-        0x1010101010101010,
-        0x2020202020202020,
-        0x4040404040404040,
-        0x8080808080808080
-    };
-
-    constexpr std::array<chess::Bitboard, 15> diagonalMasks = {
-        0x0000000000000001, // a1
-        0x0000000000000102, // a2 - b1
-        0x0000000000010204, // a3 - b2 - c1
-        0x0000000001020408, // a4 - b3 - c2 - d1
-        0x0000000102040810, // a5 - b4 - c3 - d2 - e1
-        0x0000010204081020, // a6 - b5 - c4 - d3 - e2 - f1
-        0x0001020408102040, // a7 - b6 - c5 - d4 - e3 - f2 - g1
-        0x0102040810204080, // a8 - b7 - c6 - d5 - e4 - f3 - g2 - h1
-        0x0204081020408000, // b8 - c7 - d6 - e5 - f4 - g3 - h2
-        0x0408102040800000, // c8 - d7 - e6 - f5 - g4 - h3
-        0x0810204080000000, // d8 - e7 - f6 - g5 - h4
-        0x1020408000000000, // e8 - f7 - g6 - h5
-        0x2040800000000000, // f8 - g7 - h6
-        0x4080000000000000, // g8 - h7
-        0x8000000000000000, // h8
-    };
 
-    constexpr std::array<chess::Bitboard, 15> antiDiagonalMasks {    
-        0x0000000000000080, // h1
-        0x0000000000008040, // h2 - g1
-        0x0000000000804020, // h3 - g2 - f1
-        0x0000000080402010, // h4 - g3 - f2 - e1
-        0x0000008040201008, // h5 - g4 - f3 - e2 - d1
-        0x0000804020100804, // h6 - g5 - f4 - e3 - d2 - c1
-        0x0080402010080402, // h7 - g6 - f5 - e4 - d3 - c2 - b1
-        0x8040201008040201, // h8 - g7 - f6 - e5 - d4 - c3 - b2 - a1
-        0x4020100804020100, // g8 - f7 - e6 - d5 - c4 - b3 - a2
-        0x2010080402010000, // f8 - e7 - d6 - c5 - b4 - a3
-        0x1008040201000000, // e8 - d7 - c6 - b5 - a4
-        0x0804020100000000, // d8 - c7 - b6 - a5
-        0x0402010000000000, // c8 - b7 - a6
-        0x0201000000000000, // b8 - a7
-        0x0100000000000000  // a8
-    };
-
-    int16_t longestWhitePawnChainLength = 0;
-    int16_t longestBlackPawnChainLength = 0;
-    for (auto [masks, stride] : {
-        std::pair(diagonalMasks, 9),
-        std::pair(antiDiagonalMasks, 7)
-        }) {
-        for (auto [pawnBitboard, longest] : {
-            std::pair(whitePawns, &longestWhitePawnChainLength),
-            std::pair(blackPawns, &longestBlackPawnChainLength)
-            })
-        {
-            for (chess::Bitboard diagonalMask : masks) {
-                chess::Bitboard pawnsOnDiagonal = pawnBitboard & diagonalMask;
-                int8_t prevSquare = -1;
-                int16_t currentChain = 0, bestChain = 0;
-                while (pawnsOnDiagonal) {
-                    int8_t sq = pawnsOnDiagonal.pop();
-                    if (prevSquare != -1 && sq == prevSquare + stride) currentChain++;
-                    else currentChain = 1;
-                    prevSquare = sq;
-                    bestChain = std::max(bestChain, currentChain);
-                }
-                *longest = std::max(*longest, bestChain);
-            }
-        }
+//The search's own board carries its pawn key along; any other board has it worked out from scratch.
+const PawnEntry* ChessEngine::probePawns(SearchThread* thread, chess::Board* position) {
+    uint64_t key = position == &thread->board ? thread->pawnKey : PawnHashTable::pawnKey(*position);
+    thread->counters.pawnHashProbes++;
+    bool found;
+    PawnEntry* entry = thread->pawnTable.probe(key, found);
+    if (found) {
+        thread->counters.pawnHashHits++;
+        return entry;
     }
-    return (2 << longestWhitePawnChainLength) - (2 << longestBlackPawnChainLength);
+    entry->key = key;
+    PawnHashTable::evaluate(position->pieces(chess::PieceType::PAWN, chess::Color::WHITE).getBits(),
+        position->pieces(chess::PieceType::PAWN, chess::Color::BLACK).getBits(), *entry);
+    return entry;
 }
-int16_t ChessEngine::countKingSafety(chess::Board* position) {
-    //# of checks. carries between sub-branches. figure out how the math looks for that.
-    //# of pieces pinned to the king.
-    //
-    return 0;
+
+//Pawn chains: 2 << the longest diagonal chain per side. The set-wise kernel is PawnHashTable::evaluate, the
+//search reaches it through probePawns; this is the uncached way in.
+int16_t ChessEngine::countPawnStructure(chess::Board* position) {
+    PawnEntry entry;
+    PawnHashTable::evaluate(position->pieces(chess::PieceType::PAWN, chess::Color::WHITE).getBits(),
+        position->pieces(chess::PieceType::PAWN, chess::Color::BLACK).getBits(), entry);
+    return entry.score;
 }
 
-const int16_t ChessEngine::squareValueLookupTable[8][8] = {
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 3, 3, 3, 3, 2, 2},
-    {2, 2, 3, 4, 4, 3, 2, 2},
-    {2, 2, 3, 4, 4, 3, 2, 2},
-    {2, 2, 3, 3, 3, 3, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-};
\ No newline at end of file
+int16_t ChessEngine::countKingSafety(chess::Board* position, const AttackMap& attackMap) {
+    //Per side: squares around the king our other pieces cover, minus the ones they cover (twice-covered ones
+    //count again), minus pieces pinned to the king, minus being in check.
+    int16_t kingSafety = 0;
+    for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
+        int us = int(color);
+        int them = int(~color);
+        chess::Bitboard zone = attackMap.kingZone[us];
+        chess::Bitboard kingSquare = chess::Bitboard(1ULL << position->kingSq(color).index());
+        chess::Bitboard defended = chess::Bitboard(0);
+        for (int pt = 0; pt < 5; pt++) defended |= attackMap.byType[us][pt];
+
+        int16_t safety = 2 * (zone & defended).count()
+            - 3 * (zone & attackMap.all[them]).count()
+            - 2 * (zone & attackMap.doubled[them]).count()
+            - 8 * attackMap.pinned[us].count()
+            - ((kingSquare & attackMap.all[them]) ? 16 : 0);
+        kingSafety += color == chess::Color::WHITE ? safety : -safety;
+    }
+    return kingSafety;
+}
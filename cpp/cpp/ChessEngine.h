@@ -1,8 +1,24 @@
 #pragma once
 #include "chess.hpp"
+#include "TranspositionTable.h"
+#include "AttackMap.h"
+#include "MovePicker.h"
+#include "Nnue.h"
+#include "SearchStats.h"
+#include "OpeningBook.h"
+#include "Bitbase.h"
+#include "PawnHashTable.h"
 #include <random>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 enum GameState {
     STILL_PLAYING,
@@ -11,42 +27,227 @@ enum GameState {
     WHITE_WINS
 };
 
+enum EvalType {
+    CLASSICAL_EVAL,
+    NNUE_EVAL
+};
+
+enum EvalNoise {
+    NOISE_OFF,
+    NOISE_HASHED //a pure function of the position and the game's seed, see ChessEngine::evalNoiseFor
+};
+
+const int MAX_DEPTH = 64;
+
+//Evaluations are int16_t, 256 per pawn from white's point of view. The search adds them up and compares them
+//as Score, which has room past any evaluation for mates that keep their distance: white mating n plies from
+//the root scores SCORE_MATE - n, black mating -(SCORE_MATE - n). Mates are stored in the transposition
+//table counted from the node instead, so a hit at another ply still means the same mate.
+typedef int32_t Score;
+const Score SCORE_MATE = 1 << 20;
+const Score SCORE_INFINITE = SCORE_MATE + 1;
+const Score SCORE_MATE_BOUND = SCORE_MATE - 2 * MAX_DEPTH; //anything further from zero is a mate, quiescence plies included
+const Score ASPIRATION_WINDOW = 1 << 6; //quarter pawn either side of the last iteration's score
+const int ASPIRATION_MIN_DEPTH = 4;     //shallower iterations are too cheap and too jumpy to bother
+
+const int QUIESCENCE_DELTA_MARGIN = 2 << 8; //two pawns
+const int LATE_MOVE_PRUNING_DEPTH = 3; //remaining depth up to which late quiet moves are pruned, see isLateMovePruned
+const int LMR_MIN_DEPTH = 3;           //remaining depth from which late quiet moves are reduced
+const int LMR_FULL_DEPTH_MOVES = 3;    //moves searched at full depth before reductions start
+const int LMR_TABLE_MOVES = 64;
+const int NULL_MOVE_MIN_DEPTH = 3;       //remaining depth below which passing saves too little to be worth it
+const int NULL_MOVE_REDUCTION = 2;       //base R, grows with depth and with how far the evaluation is past beta
+const int NULL_MOVE_MARGIN_STEP = 2 << 8; //one more ply of R per two pawns past beta, up to three
+const int NULL_MOVE_VERIFY_DEPTH = 8;    //from here a null-move cutoff is confirmed by a reduced search without one
+const int16_t EVAL_LIMIT = 0x3f00;        //static evaluations are clamped to this either side, about 63 pawns
+const int16_t BITBASE_WIN_SCORE = 0x4000; //a won ending, above any static evaluation (see EVAL_LIMIT) and below any mate
+const int EVAL_NOISE = 5; //hashed noise is in [-EVAL_NOISE, EVAL_NOISE]
+
+//The classical sum and the network both run past any sensible score in freak positions; clamped, only a won
+//ending or a mate ever scores past EVAL_LIMIT, which the search's won-position guards rely on.
+inline int16_t clampEvaluation(int64_t evaluation) {
+    return int16_t(std::clamp<int64_t>(evaluation, -EVAL_LIMIT, EVAL_LIMIT));
+}
+
+//What getBestMove may spend. The search deepens one ply at a time until it hits whichever limit comes first
+//and answers with the deepest iteration it finished.
+struct SearchLimits {
+    int depth = 0; //0: deepen until the deadline or node limit, up to MAX_DEPTH
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    uint64_t nodes = 0; //0: no node limit
+    const std::atomic<bool>* stop = nullptr; //another thread sets this to end the search early, e.g. on a UCI stop
+};
+
+//Reported after every iteration the main thread finishes, once per line, see setInfoCallback.
+struct SearchInfo {
+    int multiPv; //rank of the line, 1 is the best move
+    int depth;
+    Score score; //white's point of view, mates keep their distance, see SCORE_MATE
+    uint64_t nodes; //all threads
+    std::chrono::milliseconds time;
+    std::vector<chess::Move> pv; //principal variation from the root, read back out of the transposition table
+};
+
+//One of the best root moves a multi-PV search found, see setMultiPv.
+struct RootLine {
+    chess::Move move;
+    Score score; //white's point of view
+    int depth;   //of the last iteration that finished this line, lines cut off by a stop keep an older one
+    std::vector<chess::Move> pv; //starts with move
+};
+
+//Everything one search thread writes to. Lazy SMP runs several of these over the same root at once,
+//each on its own copy of the board, and they only talk to each other through the transposition table.
+struct SearchThread {
+    int id;
+    int depth;
+    chess::Board board;
+    std::atomic<uint64_t> nodes; //only written by its own thread, read by the main thread for node limits
+    chess::Move bestMove; //from the last finished iteration, searched first in the next one
+    Score bestScore;      //of bestMove, the centre of the next iteration's aspiration window
+    chess::Move rootMove; //best so far in the search running now, set by the root node
+    chess::Move rootHashMove; //searched first at the root: bestMove, or the move this line found last iteration
+    chess::Movelist excludedRootMoves; //found by the lines before the one being searched, skipped at the root
+    std::vector<RootLine> rootLines; //best first, from the last iteration that finished any
+    std::atomic<int> completedDepth; //read by a ponder hit from another thread
+    chess::Move killers[MAX_DEPTH + 1][2]; //the last two quiet moves that cut off at each ply
+    int16_t history[2][64][64]; //[color][from][to], how often a quiet move has cut off, see updateQuietHistory
+    std::vector<NnueAccumulator> accumulators; //one per ply, [accumulatorIndex] matches board
+    int accumulatorIndex;
+    SearchCounters counters;
+    PawnHashTable pawnTable;
+    uint64_t pawnKey; //of board, kept in step by makeSearchMove and unmakeSearchMove
+};
+
 class ChessEngine {
     public:
-        ChessEngine(chess::Board* board, int depth, int beamWidth);
+        ChessEngine(chess::Board* board, int depth, int beamWidth, int threads = 1, int hashSizeMB = 16);
         ~ChessEngine();
         void makeMove(chess::Move move);
         chess::Move getBestMove();
+        chess::Move getBestMove(std::chrono::milliseconds timeLimit);
+        chess::Move getBestMove(const SearchLimits& limits);
+        std::vector<RootLine> getBestMoves(int lines, const SearchLimits& limits);
+        bool startPondering();
+        void stopPondering();
         int16_t evaluate(chess::Board* position);
         bool isLegalMove(chess::Move move, chess::Board* position = nullptr);
+        static bool isValidFen(const std::string& fen);
+        static Score scoreToTable(Score score, int curDepth);
+        static Score scoreFromTable(Score score, int curDepth);
 
         //getters and setters
         chess::Board* getCurrentState() { return this->currentState; }
+        void setHashSize(int hashSizeMB) { this->transpositionTable.resize(hashSizeMB); }
+        void clearHash() { this->transpositionTable.clear(); }
+        int getThreads() { return int(this->searchThreads.size()); }
+        uint64_t getNodes() { return this->nodes; }
+        int getCompletedDepth() { return this->searchThreads[0]->completedDepth; }
+        void setSeed(uint32_t seed); //per game: evaluation noise and book choices
+        void setEvalNoise(EvalNoise evalNoise) { this->evalNoise = evalNoise; }
+        EvalNoise getEvalNoise() { return this->evalNoise; }
+        bool loadNetwork(const std::string& path);
+        bool setEvalType(EvalType evalType); //false if NNUE_EVAL is asked for before a network is loaded
+        EvalType getEvalType() { return this->evalType; }
+        const SearchStats& getSearchStats() { return this->stats; } //of the last getBestMove
+        void setStatsLogger(SearchStatsLogger* statsLogger) { this->statsLogger = statsLogger; } //nullptr to stop logging
+        //probed before every search, nullptr to always search. The book isn't owned and may be shared between engines.
+        void setOpeningBook(const OpeningBook* book, BookSelection selection = BOOK_WEIGHTED) {
+            this->book = book;
+            this->bookSelection = selection;
+        }
+        void setBitbase(const Bitbase* bitbase) { this->bitbase = bitbase; } //not owned, nullptr to search endings out
+        const std::vector<chess::Move>& getPrincipalVariation() { return this->principalVariation; } //of the last search
+        void setMultiPv(int lines) { this->multiPv = std::max(lines, 1); } //root moves every search ranks, see getRootLines
+        int getMultiPv() { return this->multiPv; }
+        const std::vector<RootLine>& getRootLines() { return this->rootLines; } //of the last search, best first
+        chess::Move getPonderMove() { return this->pondering ? this->ponderMove : chess::Move(chess::Move::NO_MOVE); }
+        bool isPondering() { return this->pondering; }
+        //called on the main search thread, keep it short
+        void setInfoCallback(std::function<void(const SearchInfo&)> infoCallback) { this->infoCallback = infoCallback; }
     private:
         chess::Movelist calculateLegalMoves(chess::Board* position);
-        chess::Move alphaBetaSearch();
-        chess::Move bestMoveForWhite(chess::Board* position, int curDepth = 0, int16_t alpha = -0x7fff, int16_t beta = 0x7fff);
-        chess::Move bestMoveForBlack(chess::Board* position, int curDepth = 0, int16_t alpha = -0x7fff, int16_t beta = 0x7fff);
+        void prepareSearch(const chess::Board& root, const SearchLimits& limits);
+        chess::Move runSearch();
+        chess::Move ponderHit(const SearchLimits& limits);
+        chess::Move iterativeDeepening(SearchThread* thread);
+        void rankRootLines(SearchThread* thread, std::vector<RootLine>& lines, int lineCount);
+        Score aspirationSearch(SearchThread* thread, Score previous);
+        Score alphaBetaSearch(SearchThread* thread, Score alpha, Score beta);
+        void countNode(SearchThread* thread);
+        void checkLimits();
+        uint64_t countAllNodes();
+        std::vector<chess::Move> extractPrincipalVariation(SearchThread* thread, chess::Move first);
+        std::chrono::steady_clock::time_point getDeadline() {
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(this->deadline.load(std::memory_order_relaxed)));
+        }
+        //curDepth is the ply from the root, remainingDepth what is left to search; the two no longer add up to
+        //thread->depth once a null move or a reduction has shortened the search. The node's best move goes
+        //into the transposition table, and at the root into thread->rootMove.
+        Score bestMoveForWhite(SearchThread* thread, int curDepth, int remainingDepth, Score alpha, Score beta, bool allowNullMove = true);
+        Score bestMoveForBlack(SearchThread* thread, int curDepth, int remainingDepth, Score alpha, Score beta, bool allowNullMove = true);
+        bool isLateMovePruned(int remainingDepth, int moveCount);
+        int lateMoveReduction(int remainingDepth, int moveCount);
+        bool tryNullMove(SearchThread* thread, chess::Color color, int curDepth, int remainingDepth, Score alpha, Score beta, Score& score);
+        Score quiescenceForWhite(SearchThread* thread, int ply, Score alpha, Score beta);
+        Score quiescenceForBlack(SearchThread* thread, int ply, Score alpha, Score beta);
+        void updateQuietHistory(SearchThread* thread, chess::Color color, int curDepth, int remainingDepth, chess::Move move, chess::Movelist* quietsTried);
+        bool isDrawByRule(chess::Board* position);
+        bool probeBitbase(SearchThread* thread, chess::Board* position, int16_t& score);
+        int16_t countKnownWin(chess::Board* position, chess::Color strong);
         GameState getGameState(chess::Board* position, chess::Movelist* legalMoves);
 
-        int16_t constantTimeEvaluate(chess::Board* position, chess::Movelist* legalMoves = nullptr);
+        int16_t constantTimeEvaluate(SearchThread* thread, chess::Board* position, chess::Movelist* legalMoves = nullptr);
+        int16_t staticEvaluate(SearchThread* thread, chess::Board* position);
+        int16_t evalNoiseFor(chess::Board* position);
+        void makeSearchMove(SearchThread* thread, chess::Move move);
+        void unmakeSearchMove(SearchThread* thread, chess::Move move);
         int16_t countMaterial(chess::Board* position);
-        int16_t countPositionalControl(chess::Board* position);
+        int16_t countPositionalControl(const AttackMap& attackMap);
         int16_t countPawnStructure(chess::Board* position);
+        const PawnEntry* probePawns(SearchThread* thread, chess::Board* position);
 
 
         //Implemented but unused
         int16_t countRelativeMaterial(chess::Board* position);
-        int16_t countPieceMobility(chess::Board* position);
-
-        //Not yet implemented
-        int16_t countKingSafety(chess::Board* position);
+        int16_t countPieceMobility(const AttackMap& attackMap);
+        int16_t countKingSafety(chess::Board* position, const AttackMap& attackMap);
 
 
         chess::Board* currentState;
         int depth;
-        int beamWidth;
+        int beamWidth; //moves searched one ply from the horizon before late-move pruning, see isLateMovePruned
         bool debug;
         std::mt19937 gen;
-        const static int16_t squareValueLookupTable[8][8];
+        TranspositionTable transpositionTable;
+        NnueNetwork network;
+        EvalType evalType;
+        EvalNoise evalNoise;
+        uint64_t noiseSeed;
+        std::vector<std::unique_ptr<SearchThread>> searchThreads; //[0] is the main thread
+        std::atomic<bool> stopSearch;
+        //the caller's SearchLimits, as atomics a ponder hit can change while the search runs
+        std::atomic<int> depthLimit;
+        std::atomic<std::chrono::steady_clock::rep> deadline;
+        std::atomic<std::chrono::steady_clock::rep> budgetStart; //when the time to deadline started counting
+        std::atomic<uint64_t> nodeLimit; //0: none, else a total over all threads; a ponder hit adds what was already searched
+        std::atomic<const std::atomic<bool>*> externalStop;
+        std::chrono::steady_clock::time_point searchStart;
+        uint64_t nodes;
+        SearchStats stats;
+        SearchStatsLogger* statsLogger;
+        const OpeningBook* book;
+        BookSelection bookSelection;
+        const Bitbase* bitbase;
+        std::function<void(const SearchInfo&)> infoCallback;
+        std::vector<chess::Move> principalVariation;
+        int multiPv;
+        std::vector<RootLine> rootLines;
+        uint64_t afterBestMoveHash; //the position the last search's move leads to, where pondering starts from
+
+        bool pondering;
+        std::thread ponderThread;
+        chess::Board ponderBoard;
+        chess::Move ponderMove;
+        chess::Move ponderResult;
 };
\ No newline at end of file
@@ -1,402 +1,274 @@
 #include "GameTree.h"
+#include <algorithm>
 
-GameTreeNode::GameTreeNode(chess::PackedBoard position, int16_t score) {
-	this->position = position;
-	this->score = score;
+NodeArena::NodeArena(size_t capacity) {
+	this->capacity = uint32_t(std::min<size_t>(std::max<size_t>(capacity, 1), NO_NODE - 1));
+	this->nodes = std::make_unique<GameTreeNode[]>(this->capacity);
+	this->used = 0;
 }
 
-void GameTreeNode::destroy(GameTreeNode* goldenChild) {
-	//delete all our children except for the golden child
-	//eventually, we will look ourselves up to ensure that all our parents were destroyed as well
-	for (GameTreeNode* child : children) {
-		if (child != goldenChild) {
-			child->destroy(nullptr);
-		}
-	}
-	delete this;
+uint32_t NodeArena::allocate(uint32_t count) {
+	if (count > this->capacity - this->used) return NO_NODE;
+	uint32_t first = this->used;
+	this->used += count;
+	return first;
 }
 
-
-int16_t GameTreeNode::constantTimeEvaluate(chess::Movelist* legalMoves) { 
-    switch (getGameState(position, legalMoves)) {
-    case STILL_PLAYING:
-        break;
-    case BLACK_WINS:
-        return -0x7fff;
-    case DRAW:
-        return 0;
-    case WHITE_WINS:
-        return 0x7fff;
-    }
-
-    int16_t result = (countMaterial(position) << 8) + (countPositionalControl(position)) + (countPawnStructure(position)) + std::uniform_int_distribution<int>(-5, 5)(this->gen);
-    return result;
+//the memory is split between the live arena and the spare one a kept subtree gets copied into
+GameTree::GameTree(ChessEngine* evaluator, const chess::Board& board, int sizeMB) :
+	arenas{ NodeArena(size_t(sizeMB) * 1024 * 1024 / 2 / sizeof(GameTreeNode)), NodeArena(size_t(sizeMB) * 1024 * 1024 / 2 / sizeof(GameTreeNode)) } {
+	this->evaluator = evaluator;
+	this->board = board;
+	this->active = 0;
+	this->beamWidth = 0;
+	this->nodesVisited = 0;
+	this->reusedNodes = 0;
+	this->root = this->newRoot();
 }
 
-GameTreeNode* GameTreeNode::alphaBetaSearch() {
-    if (this->currentState->sideToMove() == chess::Color::WHITE) {
-        return this->bestMoveForWhite(this->currentState);
-    }
-    return this->bestMoveForBlack(this->currentState);
+uint32_t GameTree::newRoot() {
+	this->arena().reset();
+	uint32_t index = this->arena().allocate(1);
+	GameTreeNode& node = this->arena()[index];
+	node.move = chess::Move::NO_MOVE;
+	node.score = 0;
+	node.depth = -1;
+	node.bound = TT_NONE;
+	node.childCount = 0;
+	node.firstChild = NO_NODE;
+	return index;
 }
 
-chess::Move GameTreeNode::bestMoveForWhite(chess::Board* position, int curDepth, int16_t alpha, int16_t beta) {
-    chess::Movelist legalMoves = calculateLegalMoves(position);
-    chess::Move toReturn = chess::Move();
-    toReturn.setScore(-0x7fff);
-    if (curDepth >= this->depth || getGameState(position, &legalMoves) != STILL_PLAYING) {
-        toReturn.setScore(constantTimeEvaluate(position, &legalMoves));
-        return toReturn;
-    }
-
-    position->makeNullMove();
-    int16_t lowerLimit = bestMoveForBlack(position, depth).score();
-    position->unmakeNullMove();
-
-    for (chess::Move& move : legalMoves) {
-        position->makeMove(move);
-        move.setScore(constantTimeEvaluate(position));
-        position->unmakeMove(move);
-    }
-
-    std::sort(legalMoves.begin(), legalMoves.end(), std::greater<chess::Move>());
-
-    for (int i = 0; i < std::min(this->beamWidth, legalMoves.size()); i++) {
-        if (this->debug) {
-            for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Looking at " << chess::uci::moveToSan(*position, legalMoves[i]) << std::endl;
-        }
-
-        if (legalMoves[i].score() < lowerLimit) continue;
-
-        position->makeMove(legalMoves[i]);
-        legalMoves[i].setScore(bestMoveForBlack(position, curDepth + 1, alpha, beta).score());
-        position->unmakeMove(legalMoves[i]);
+chess::Move GameTree::alphaBetaSearch(int depth, int beamWidth) {
+	this->beamWidth = beamWidth;
+	this->nodesVisited = 0;
+	bool white = this->board.sideToMove() == chess::Color::WHITE;
 
-        if (this->debug) {
-            for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << " score: " << legalMoves[i].score() << std::endl;
-        }
-        toReturn = toReturn > legalMoves[i] ? toReturn : legalMoves[i];
+	//iterative deepening re-ranks the root's children every iteration, on a warm tree the first
+	//iterations are mostly answered from the scores the last search left behind
+	for (int iterationDepth = 1; iterationDepth <= std::min(depth, MAX_DEPTH - 1); iterationDepth++) {
+		if (white) this->bestMoveForWhite(this->root, 0, iterationDepth, -SCORE_INFINITE, SCORE_INFINITE);
+		else this->bestMoveForBlack(this->root, 0, iterationDepth, -SCORE_INFINITE, SCORE_INFINITE);
+	}
 
-        if (legalMoves[i].score() >= beta) {
-            break;
-        }
-        alpha = std::max(alpha, legalMoves[i].score());
-    }
-    if (this->debug) {
-        for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-        std::cout << "Picked move: " << chess::uci::moveToSan(*position, toReturn) << std::endl;
-    }
-    return toReturn;
+	GameTreeNode& root = this->arena()[this->root];
+	if (root.firstChild == NO_NODE || root.childCount == 0) return chess::Move(chess::Move::NO_MOVE);
+	return chess::Move(this->arena()[root.firstChild].move);
 }
 
-chess::Move GameTreeNode::bestMoveForBlack(chess::Board* position, int curDepth, int16_t alpha, int16_t beta) {
-    chess::Movelist legalMoves = calculateLegalMoves(position);
-    chess::Move toReturn = chess::Move();
-    toReturn.setScore(0x7fff);
-    if (curDepth >= this->depth || getGameState(position, &legalMoves) != STILL_PLAYING) {
-        toReturn.setScore(constantTimeEvaluate(position, &legalMoves));
-        return toReturn;
-    }
-
-    position->makeNullMove();
-    int16_t upperLimit = bestMoveForWhite(position, depth).score();
-    position->unmakeNullMove();
-
-    for (chess::Move& move : legalMoves) {
-        position->makeMove(move);
-        move.setScore(constantTimeEvaluate(position));
-        position->unmakeMove(move);
-    }
-
-    std::sort(legalMoves.begin(), legalMoves.end());
-
-    for (int i = 0; i < std::min(this->beamWidth, legalMoves.size()); i++) {
-        if (this->debug) {
-            for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Looking at " << chess::uci::moveToSan(*position, legalMoves[i]) << std::endl;
-        }
-        if (legalMoves[i].score() > upperLimit) continue;
-        position->makeMove(legalMoves[i]);
-        legalMoves[i].setScore(bestMoveForWhite(position, curDepth + 1, alpha, beta).score());
-        position->unmakeMove(legalMoves[i]);
+void GameTree::makeMove(chess::Move move) {
+	GameTreeNode& root = this->arena()[this->root];
+	uint32_t kept = NO_NODE;
+	for (uint32_t i = 0; root.firstChild != NO_NODE && i < root.childCount; i++) {
+		if (this->arena()[root.firstChild + i].move == move.move()) kept = root.firstChild + i;
+	}
+	this->board.makeMove(move);
 
-        if (this->debug) {
-            for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << " score: " << legalMoves[i].score() << std::endl;
-        }
-        toReturn = toReturn < legalMoves[i] ? toReturn : legalMoves[i];
+	if (kept == NO_NODE) {
+		this->root = this->newRoot();
+		this->reusedNodes = 0;
+		return;
+	}
 
-        if (legalMoves[i].score() <= alpha) {
-            break;
-        }
-        if (this->debug) {
-            for (int j = 0; j < curDepth; j++) { std::cout << "\t"; }
-            std::cout << "Picked move: " << chess::uci::moveToSan(*position, toReturn) << std::endl;
-        }
-        beta = std::min(beta, legalMoves[i].score());
-    }
-    return toReturn;
+	//copy what is kept over to the spare arena, then drop the old one whole
+	NodeArena& from = this->arena();
+	NodeArena& to = this->arenas[1 - this->active];
+	to.reset();
+	uint32_t newRoot = to.allocate(1);
+	to[newRoot] = from[kept];
+	copyChildren(from[kept], from, to[newRoot], to);
+	from.reset();
+
+	this->active = 1 - this->active;
+	this->root = newRoot;
+	this->reusedNodes = to.getUsed();
 }
 
-GameState GameTreeNode::getGameState(chess::Board* position, chess::Movelist* legalMoves) {
-    if (position->isInsufficientMaterial()) return DRAW;
-    if (position->isRepetition()) return DRAW;
-    if (position->isHalfMoveDraw() || legalMoves->empty()) {
-        if (position->inCheck()) return position->sideToMove() == chess::Color::WHITE ? BLACK_WINS : WHITE_WINS;
-        return DRAW;
-    }
-    return STILL_PLAYING;
+//Children stay together as a block, so a node's whole child array is copied before any of the children's own.
+//The spare arena is as big as the live one, so a subtree of it always fits.
+void GameTree::copyChildren(GameTreeNode& from, NodeArena& fromArena, GameTreeNode& to, NodeArena& toArena) {
+	if (from.firstChild == NO_NODE) return;
+	uint32_t block = toArena.allocate(from.childCount);
+	std::copy(&fromArena[from.firstChild], &fromArena[from.firstChild] + from.childCount, &toArena[block]);
+	to.firstChild = block;
+	for (uint32_t i = 0; i < from.childCount; i++) {
+		copyChildren(fromArena[from.firstChild + i], fromArena, toArena[block + i], toArena);
+	}
 }
 
+//Makes the children of a node, ordered best first by their static evaluation. False if the arena is full, in
+//which case the node is searched as a leaf.
+bool GameTree::expand(uint32_t index) {
+	chess::Movelist legalMoves;
+	chess::movegen::legalmoves(legalMoves, this->board);
+	uint32_t block = this->arena().allocate(legalMoves.size());
+	if (block == NO_NODE) return false;
+
+	bool white = this->board.sideToMove() == chess::Color::WHITE;
+	for (int i = 0; i < legalMoves.size(); i++) {
+		GameTreeNode& child = this->arena()[block + i];
+		this->board.makeMove(legalMoves[i]);
+		child.move = legalMoves[i].move();
+		child.score = this->evaluate();
+		child.depth = -1;
+		child.bound = TT_NONE;
+		child.childCount = 0;
+		child.firstChild = NO_NODE;
+		this->board.unmakeMove(legalMoves[i]);
+	}
+	std::stable_sort(&this->arena()[block], &this->arena()[block] + legalMoves.size(), [white](const GameTreeNode& a, const GameTreeNode& b) {
+		return white ? a.score > b.score : a.score < b.score;
+	});
+
+	GameTreeNode& node = this->arena()[index];
+	node.childCount = uint16_t(legalMoves.size());
+	node.firstChild = block;
+	return true;
+}
 
-int16_t GameTreeNode::countMaterial(chess::Board* position) {
-    int16_t total = 0;
-    for (std::pair < chess::PieceType, int16_t> piece : {
-        std::pair{chess::PieceType::PAWN, 1},
-        std::pair{chess::PieceType::BISHOP, 3},
-        std::pair{chess::PieceType::KNIGHT, 3},
-        std::pair{chess::PieceType::ROOK, 5},
-        std::pair{chess::PieceType::QUEEN,9}
-        }) {
-        total += (position->pieces(piece.first, chess::Color::WHITE).count()) * piece.second;
-        total -= (position->pieces(piece.first, chess::Color::BLACK).count()) * piece.second;
-    }
-    return total;
+void GameTree::store(GameTreeNode& node, int ply, int depth, Score score, Score alphaOrig, Score betaOrig) {
+	node.score = ChessEngine::scoreToTable(score, ply);
+	node.depth = int8_t(depth);
+	node.bound = score >= betaOrig ? TT_LOWER : score <= alphaOrig ? TT_UPPER : TT_EXACT;
 }
 
-int16_t GameTreeNode::countRelativeMaterial(chess::Board* position) {
-    int16_t total = 0;
-    int16_t difference = 0;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            chess::Piece piece = position->at(chess::Square(chess::File(i), chess::Rank(j)));
-            if (piece == chess::Piece::NONE) {
-                continue;
-            }
-            else if (piece == chess::Piece::WHITEPAWN) {
-                total += 1;
-                difference += 1;
-            }
-            else if (piece == chess::Piece::WHITEKNIGHT) {
-                total += 3;
-                difference += 3;
-            }
-            else if (piece == chess::Piece::WHITEBISHOP) {
-                total += 3;
-                difference += 3;
-            }
-            else if (piece == chess::Piece::WHITEROOK) {
-                total += 5;
-                difference += 5;
-            }
-            else if (piece == chess::Piece::WHITEQUEEN) {
-                total += 9;
-                difference += 9;
-            }
-            else if (piece == chess::Piece::WHITEKING) {
-                total += 0;
-                difference += 0;
-            }
-            else if (piece == chess::Piece::BLACKPAWN) {
-                total += 1;
-                difference -= 1;
-            }
-            else if (piece == chess::Piece::BLACKKNIGHT) {
-                total += 3;
-                difference -= 3;
-            }
-            else if (piece == chess::Piece::BLACKBISHOP) {
-                total += 3;
-                difference -= 3;
-            }
-            else if (piece == chess::Piece::BLACKROOK) {
-                total += 5;
-                difference -= 5;
-            }
-            else if (piece == chess::Piece::BLACKQUEEN) {
-                total += 9;
-                difference -= 9;
-            }
-            else if (piece == chess::Piece::BLACKKING) {
-                total += 0;
-                difference -= 0;
-            }
-        }
-    }
-    return (difference << 15) / total; //TODO: maybe a cheaper operation?
+//Late-move pruning the way the engine does it, see ChessEngine::isLateMovePruned: close to the horizon, a
+//child this far down the ranking is skipped unless it captures or the side to move is in check. The root's
+//children are always searched, one of them is the move handed back.
+bool GameTree::searchesChild(const GameTreeNode& child, int ply, int depth, uint32_t moveCount, bool inCheck) {
+	if (ply == 0 || inCheck || depth > LATE_MOVE_PRUNING_DEPTH || moveCount < uint32_t(this->beamWidth + depth * depth)) return true;
+	return this->board.isCapture(chess::Move(child.move));
 }
 
-int16_t GameTreeNode::countPositionalControl(chess::Board* position) {
-    int16_t positionalControl = 0;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            chess::Square square = chess::Square(chess::File(i), chess::Rank(j));
-            int16_t squareValue = GameTreeNode::squareValueLookupTable[i][j];
-            chess::Bitboard blackAttackers = chess::attacks::attackers(*position, chess::Color::BLACK, square);
-            positionalControl -= blackAttackers.count() * squareValue;
-            chess::Bitboard whiteAttackers = chess::attacks::attackers(*position, chess::Color::WHITE, square);
-            positionalControl += whiteAttackers.count() * squareValue;
-        }
-    }
-    return positionalControl;
+//A skipped child's score is from an older visit or only its static evaluation, so it must not rank above
+//anything this visit searched. It goes below all of them and is searched afresh the next time it comes up.
+void GameTree::skipChild(GameTreeNode& child, bool white) {
+	child.score = white ? -SCORE_INFINITE : SCORE_INFINITE;
+	child.depth = -1;
+	child.bound = TT_NONE;
 }
 
-int16_t GameTreeNode::countPieceMobility(chess::Board* position) {
-    int16_t pieceMobility = 0;
-    for (chess::Color color : {chess::Color::WHITE, chess::Color::BLACK}) {
+//The static evaluation of the board as a node score: counted from the node, so a mate on the board itself
+//is SCORE_MATE rather than the evaluation's +-0x7fff, and ranks with mates the search found.
+Score GameTree::evaluate() {
+	int16_t evaluation = this->evaluator->evaluate(&this->board);
+	if (evaluation == 0x7fff) return SCORE_MATE;
+	if (evaluation == -0x7fff) return -SCORE_MATE;
+	return evaluation;
+}
 
-        chess::Bitboard bitboard = position->pieces(chess::PieceType::PAWN, color);
+Score GameTree::bestMoveForWhite(uint32_t index, int ply, int depth, Score alpha, Score beta) {
+	GameTreeNode& node = this->arena()[index];
+	this->nodesVisited++;
+	if (ply > 0 && (this->board.isInsufficientMaterial() || this->board.isRepetition() || this->board.isHalfMoveDraw())) {
+		this->store(node, ply, depth, 0, -SCORE_INFINITE, SCORE_INFINITE);
+		return 0;
+	}
 
-        while (bitboard) {
-            uint8_t sqIndex = bitboard.pop();
-            if (color == chess::Color::WHITE) {
-                pieceMobility += chess::attacks::pawn(color, chess::Square(sqIndex)).count();
-            }
-            else {
-                pieceMobility -= chess::attacks::pawn(color, chess::Square(sqIndex)).count();
-            }
-        }
+	//a node is one path from the root, so a stored score is exactly as good as a transposition table hit
+	Score stored = ChessEngine::scoreFromTable(node.score, ply);
+	if (ply > 0 && node.depth >= depth && (
+		node.bound == TT_EXACT ||
+		(node.bound == TT_LOWER && stored >= beta) ||
+		(node.bound == TT_UPPER && stored <= alpha))) {
+		return stored;
+	}
+	if (depth == 0 || (node.firstChild == NO_NODE && !this->expand(index))) {
+		Score score = ChessEngine::scoreFromTable(this->evaluate(), ply);
+		this->store(node, ply, 0, score, -SCORE_INFINITE, SCORE_INFINITE);
+		return score;
+	}
+	bool inCheck = this->board.inCheck();
+	if (node.childCount == 0) {
+		Score score = inCheck ? -(SCORE_MATE - ply) : 0;
+		this->store(node, ply, depth, score, -SCORE_INFINITE, SCORE_INFINITE);
+		return score;
+	}
 
-        bitboard = position->pieces(chess::PieceType::KNIGHT, color);
-        while (bitboard) {
-            uint8_t sqIndex = bitboard.pop();
-            if (color == chess::Color::WHITE) {
-                pieceMobility += chess::attacks::knight(chess::Square(sqIndex)).count();
-            }
-            else {
-                pieceMobility -= chess::attacks::knight(chess::Square(sqIndex)).count();
-            }
-        }
+	Score alphaOrig = alpha;
+	Score best = -SCORE_INFINITE;
+	uint32_t considered = 0;
+	for (; considered < node.childCount; considered++) {
+		GameTreeNode& child = this->arena()[node.firstChild + considered];
+		if (!this->searchesChild(child, ply, depth, considered, inCheck)) {
+			this->skipChild(child, true);
+			continue;
+		}
+		chess::Move move = chess::Move(child.move);
+		this->board.makeMove(move);
+		Score score = this->bestMoveForBlack(node.firstChild + considered, ply + 1, depth - 1, alpha, beta);
+		this->board.unmakeMove(move);
+
+		best = std::max(best, score);
+		if (score >= beta) {
+			considered++;
+			break;
+		}
+		alpha = std::max(alpha, score);
+	}
 
-        chess::Bitboard occupied = position->occ();
-        auto handleSlidingPiece = [&](chess::PieceType type, auto attackFunc) {
-            bitboard = position->pieces(type, color);
-            while (bitboard) {
-                uint8_t sqIndex = bitboard.pop();
-                if (color == chess::Color::WHITE) {
-                    pieceMobility += attackFunc(chess::Square(sqIndex), occupied).count();
-                }
-                else {
-                    pieceMobility -= attackFunc(chess::Square(sqIndex), occupied).count();
-                }
-            }
-            };
-        handleSlidingPiece(chess::PieceType::BISHOP, chess::attacks::bishop);
-        handleSlidingPiece(chess::PieceType::ROOK, chess::attacks::rook);
-        handleSlidingPiece(chess::PieceType::QUEEN, chess::attacks::queen);
-    }
-    return pieceMobility;
+	//rank what was looked at by what the search found, so the next visit tries the best move first; skipped
+	//children sink below the searched ones, and the children's mates are all counted from the same ply, so
+	//they compare as they are
+	std::stable_sort(&this->arena()[node.firstChild], &this->arena()[node.firstChild] + considered, [](const GameTreeNode& a, const GameTreeNode& b) {
+		return a.score > b.score;
+	});
+	this->store(node, ply, depth, best, alphaOrig, beta);
+	return best;
 }
-int16_t GameTreeNode::countPawnStructure(chess::Board* position) {
-    chess::Bitboard whitePawns = position->pieces(chess::PieceType::PAWN, chess::Color::WHITE);
-    chess::Bitboard blackPawns = position->pieces(chess::PieceType::PAWN, chess::Color::BLACK);
-
-    //How are we counting pawn structure?
-    //Length of pawn chains: each pawn is part of a chain. I'm thinking we do, for each pawn, score += 1 << std::min(4, pawnChainLength)
-    //Pawn islands: each pawn is part of an island. Get the width of that island. This punishes isolated and doubled pawns. We can do, for each island, score += 1 << min(6, islandWidth).
-
-    //so we wanna do it by file. a, b, c... What's the best way to do it? Bits are ordered as a1, b1, c1, d1, etc...
-    //Create a bitmask for each file. Then, make a file bitboard by ANDing the bitmask with the pawn bitboard. Then, use LSB on that. 
-    int64_t fileA = 0x0101010101010101;
-    int64_t fileB = 0x0202020202020202;
-    int64_t fileC = 0x0404040404040404;
-    int64_t fileD = 0x0808080808080808;
-    int64_t fileE = 0x1010101010101010;
-    int64_t fileF = 0x2020202020202020;
-    int64_t fileG = 0x4040404040404040;
-    int64_t fileH = 0x8080808080808080;
 
-    int64_t fileMasks[8] = {
-        0x0101010101010101,
-        0x0202020202020202,
-        0x0404040404040404,
-        0x0808080808080808,
-        0x1010101010101010,
-        0x2020202020202020,
-        0x4040404040404040,
-        0x8080808080808080
-    };
+Score GameTree::bestMoveForBlack(uint32_t index, int ply, int depth, Score alpha, Score beta) {
+	GameTreeNode& node = this->arena()[index];
+	this->nodesVisited++;
+	if (ply > 0 && (this->board.isInsufficientMaterial() || this->board.isRepetition() || this->board.isHalfMoveDraw())) {
+		this->store(node, ply, depth, 0, -SCORE_INFINITE, SCORE_INFINITE);
+		return 0;
+	}
 
-    constexpr std::array<chess::Bitboard, 15> diagonalMasks = {
-        0x0000000000000001, // a1
-        0x0000000000000102, // a2 - b1
-        0x0000000000010204, // a3 - b2 - c1
-        0x0000000001020408, // a4 - b3 - c2 - d1
-        0x0000000102040810, // a5 - b4 - c3 - d2 - e1
-        0x0000010204081020, // a6 - b5 - c4 - d3 - e2 - f1
-        0x0001020408102040, // a7 - b6 - c5 - d4 - e3 - f2 - g1
-        0x0102040810204080, // a8 - b7 - c6 - d5 - e4 - f3 - g2 - h1
-        0x0204081020408000, // b8 - c7 - d6 - e5 - f4 - g3 - h2
-        0x0408102040800000, // c8 - d7 - e6 - f5 - g4 - h3
-        0x0810204080000000, // d8 - e7 - f6 - g5 - h4
-        0x1020408000000000, // e8 - f7 - g6 - h5
-        0x2040800000000000, // f8 - g7 - h6
-        0x4080000000000000, // g8 - h7
-        0x8000000000000000, // h8
-    };
+	Score stored = ChessEngine::scoreFromTable(node.score, ply);
+	if (ply > 0 && node.depth >= depth && (
+		node.bound == TT_EXACT ||
+		(node.bound == TT_LOWER && stored >= beta) ||
+		(node.bound == TT_UPPER && stored <= alpha))) {
+		return stored;
+	}
+	if (depth == 0 || (node.firstChild == NO_NODE && !this->expand(index))) {
+		Score score = ChessEngine::scoreFromTable(this->evaluate(), ply);
+		this->store(node, ply, 0, score, -SCORE_INFINITE, SCORE_INFINITE);
+		return score;
+	}
+	bool inCheck = this->board.inCheck();
+	if (node.childCount == 0) {
+		Score score = inCheck ? SCORE_MATE - ply : 0;
+		this->store(node, ply, depth, score, -SCORE_INFINITE, SCORE_INFINITE);
+		return score;
+	}
 
-    constexpr std::array<chess::Bitboard, 15> antiDiagonalMasks{
-        0x0000000000000080, // h1
-        0x0000000000008040, // h2 - g1
-        0x0000000000804020, // h3 - g2 - f1
-        0x0000000080402010, // h4 - g3 - f2 - e1
-        0x0000008040201008, // h5 - g4 - f3 - e2 - d1
-        0x0000804020100804, // h6 - g5 - f4 - e3 - d2 - c1
-        0x0080402010080402, // h7 - g6 - f5 - e4 - d3 - c2 - b1
-        0x8040201008040201, // h8 - g7 - f6 - e5 - d4 - c3 - b2 - a1
-        0x4020100804020100, // g8 - f7 - e6 - d5 - c4 - b3 - a2
-        0x2010080402010000, // f8 - e7 - d6 - c5 - b4 - a3
-        0x1008040201000000, // e8 - d7 - c6 - b5 - a4
-        0x0804020100000000, // d8 - c7 - b6 - a5
-        0x0402010000000000, // c8 - b7 - a6
-        0x0201000000000000, // b8 - a7
-        0x0100000000000000  // a8
-    };
+	Score betaOrig = beta;
+	Score best = SCORE_INFINITE;
+	uint32_t considered = 0;
+	for (; considered < node.childCount; considered++) {
+		GameTreeNode& child = this->arena()[node.firstChild + considered];
+		if (!this->searchesChild(child, ply, depth, considered, inCheck)) {
+			this->skipChild(child, false);
+			continue;
+		}
+		chess::Move move = chess::Move(child.move);
+		this->board.makeMove(move);
+		Score score = this->bestMoveForWhite(node.firstChild + considered, ply + 1, depth - 1, alpha, beta);
+		this->board.unmakeMove(move);
+
+		best = std::min(best, score);
+		if (score <= alpha) {
+			considered++;
+			break;
+		}
+		beta = std::min(beta, score);
+	}
 
-    int16_t longestWhitePawnChainLength = 0;
-    int16_t longestBlackPawnChainLength = 0;
-    for (auto [masks, stride] : {
-        std::pair(diagonalMasks, 9),
-        std::pair(antiDiagonalMasks, 7)
-        }) {
-        for (auto [pawnBitboard, longest] : {
-            std::pair(whitePawns, &longestWhitePawnChainLength),
-            std::pair(blackPawns, &longestBlackPawnChainLength)
-            })
-        {
-            for (chess::Bitboard diagonalMask : masks) {
-                chess::Bitboard pawnsOnDiagonal = pawnBitboard & diagonalMask;
-                int8_t prevSquare = -1;
-                int16_t currentChain = 0, bestChain = 0;
-                while (pawnsOnDiagonal) {
-                    int8_t sq = pawnsOnDiagonal.pop();
-                    if (prevSquare != -1 && sq == prevSquare + stride) currentChain++;
-                    else currentChain = 1;
-                    prevSquare = sq;
-                    bestChain = std::max(bestChain, currentChain);
-                }
-                *longest = std::max(*longest, bestChain);
-            }
-        }
-    }
-    return (2 << longestWhitePawnChainLength) - (2 << longestBlackPawnChainLength);
+	std::stable_sort(&this->arena()[node.firstChild], &this->arena()[node.firstChild] + considered, [](const GameTreeNode& a, const GameTreeNode& b) {
+		return a.score < b.score;
+	});
+	this->store(node, ply, depth, best, alpha, betaOrig);
+	return best;
 }
-int16_t GameTreeNode::countKingSafety(chess::Board* position) {
-    //# of checks. carries between sub-branches. figure out how the math looks for that.
-    //# of pieces pinned to the king.
-    //
-    return 0;
-}
-
-const int16_t GameTreeNode::squareValueLookupTable[8][8] = {
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 3, 3, 3, 3, 2, 2},
-    {2, 2, 3, 4, 4, 3, 2, 2},
-    {2, 2, 3, 4, 4, 3, 2, 2},
-    {2, 2, 3, 3, 3, 3, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-    {2, 2, 2, 2, 2, 2, 2, 2},
-};
\ No newline at end of file
@@ -1,24 +1,83 @@
 #pragma once
 #include "chess.hpp"
+#include "ChessEngine.h"
+#include <cstdint>
+#include <memory>
 
+const uint32_t NO_NODE = 0xffffffff;
 
-class GameTreeNode {
+//One position in the tree, 16 bytes. A node doesn't hold its board: the search replays moves on one board on
+//the way down, so the move that led here is all it needs. Children sit next to each other in the arena and
+//are found by index, so a node can be moved (sorted, or copied to another arena) as a plain struct.
+struct GameTreeNode {
+	Score score;         //white's point of view, as searched to depth, see bound; mates counted from this node
+	uint32_t firstChild; //NO_NODE until the node is expanded
+	uint16_t move;       //chess::Move::move() of the move from the parent
+	uint16_t childCount;
+	int8_t depth;        //remaining depth the score was searched to, -1 if never searched
+	uint8_t bound;       //TTBound
+};
+
+//Bump allocator over a fixed block of nodes. Nothing is ever freed one node at a time, the whole arena is
+//reset at once.
+class NodeArena {
 public:
-	GameTreeNode(chess::PackedBoard position, int16_t score);
-	void destroy(GameTreeNode* goldenChild);
+	NodeArena(size_t capacity);
+	uint32_t allocate(uint32_t count); //NO_NODE when full
+	void reset() { this->used = 0; }
 
-	GameTreeNode alphaBetaSearch();
-	GameTreeNode bestMoveForWhite(int curDepth = 0, int16_t alpha = -0x7fff, int16_t beta = 0x7fff);
-	GameTreeNode bestMoveForBlack(int curDepth = 0, int16_t alpha = -0x7fff, int16_t beta = 0x7fff);
+	//getters and setters
+	GameTreeNode& operator[](uint32_t index) { return this->nodes[index]; }
+	uint32_t getUsed() { return this->used; }
+	uint32_t getCapacity() { return this->capacity; }
 private:
-	~GameTreeNode() {}
-	std::list<GameTreeNode*> children;
-	chess::PackedBoard position;
-	int16_t score;
-
-	int16_t constantTimeEvaluate(chess::Movelist* legalMoves = nullptr);
-	int16_t countMaterial(chess::Board* position);
-	int16_t countPositionalControl(chess::Board* position);
-	int16_t countPawnStructure(chess::Board* position);
+	std::unique_ptr<GameTreeNode[]> nodes;
+	uint32_t capacity;
+	uint32_t used;
 };
 
+//A search tree that outlives the search. Every node remembers its children, in the order the last search
+//ranked them, and its backed-up score, so searching the same position again visits the best moves first and
+//answers from stored scores where they are deep enough.
+//
+//When a move is played, the subtree under it becomes the new root and the rest of the tree is dropped: the
+//kept subtree is copied into the spare arena, which costs only what is kept, and the old arena is reset in
+//O(1) however much of it is thrown away. The next search then starts from everything the last one learned
+//about the new position. Mates are stored counted from their node, like the transposition table does, so
+//they stay right when the root moves down a ply.
+//
+//The tree is a structure of its own, the engine's search doesn't go through it; bench --game-tree measures
+//what the reuse saves.
+class GameTree {
+public:
+	GameTree(ChessEngine* evaluator, const chess::Board& board, int sizeMB = 64);
+	chess::Move alphaBetaSearch(int depth, int beamWidth); //beamWidth as for ChessEngine, see searchesChild
+	void makeMove(chess::Move move);
+
+	//getters and setters
+	const chess::Board& getBoard() { return this->board; }
+	uint32_t getTreeSize() { return this->arenas[this->active].getUsed(); }
+	uint64_t getNodesVisited() { return this->nodesVisited; }
+	uint32_t getReusedNodes() { return this->reusedNodes; } //kept by the last makeMove
+	Score getScore() { return this->arenas[this->active][this->root].score; } //of the last search, white's point of view
+private:
+	Score bestMoveForWhite(uint32_t index, int ply, int depth, Score alpha, Score beta);
+	Score bestMoveForBlack(uint32_t index, int ply, int depth, Score alpha, Score beta);
+	bool searchesChild(const GameTreeNode& child, int ply, int depth, uint32_t moveCount, bool inCheck);
+	void skipChild(GameTreeNode& child, bool white);
+	Score evaluate();
+	bool expand(uint32_t index);
+	void store(GameTreeNode& node, int ply, int depth, Score score, Score alphaOrig, Score betaOrig);
+	uint32_t newRoot();
+	void copyChildren(GameTreeNode& from, NodeArena& fromArena, GameTreeNode& to, NodeArena& toArena);
+	NodeArena& arena() { return this->arenas[this->active]; }
+
+	ChessEngine* evaluator;
+	chess::Board board;
+	NodeArena arenas[2];
+	int active;
+	uint32_t root;
+	int beamWidth;
+	uint64_t nodesVisited;
+	uint32_t reusedNodes;
+};
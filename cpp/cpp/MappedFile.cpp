@@ -0,0 +1,80 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    this->data = nullptr;
+    this->size = 0;
+#ifdef _WIN32
+    this->fileHandle = nullptr;
+    this->mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    this->close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    this->close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    this->fileHandle = file;
+    this->mappingHandle = mapping;
+    this->size = size_t(fileSize.QuadPart);
+    this->data = static_cast<const unsigned char*>(view);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); //the mapping keeps the file open
+    if (view == MAP_FAILED) return false;
+    //lookups jump around the file, read-ahead would only pull in pages nobody asked for
+    madvise(view, fileStat.st_size, MADV_RANDOM);
+    this->size = size_t(fileStat.st_size);
+    this->data = static_cast<const unsigned char*>(view);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+    CloseHandle(this->mappingHandle);
+    CloseHandle(this->fileHandle);
+    this->fileHandle = nullptr;
+    this->mappingHandle = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(this->data), this->size);
+#endif
+    this->data = nullptr;
+    this->size = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//A whole file mapped read-only into memory: pages are read in when first touched and the operating system
+//shares them between every process that maps the same file.
+class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path); //false if it can't be mapped or is empty
+        void close();
+
+        //getters and setters
+        bool isOpen() const { return this->data != nullptr; }
+        const unsigned char* getData() const { return this->data; }
+        size_t getSize() const { return this->size; }
+    private:
+        const unsigned char* data;
+        size_t size;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+};
@@ -0,0 +1,134 @@
+#include "MovePicker.h"
+#include <utility>
+
+//indexed by chess::PieceType: pawn, knight, bishop, rook, queen, king, none
+static const int16_t pieceValues[7] = { 1, 3, 3, 5, 9, 0, 0 };
+
+MovePicker::MovePicker(chess::Board* position, chess::Move hashMove, const chess::Move* killers, const int16_t (*history)[64]) {
+    this->position = position;
+    this->hashMove = hashMove;
+    this->killers[0] = killers[0];
+    this->killers[1] = killers[1];
+    this->history = history;
+    this->stage = PICK_GENERATE_CAPTURES;
+    this->captureIndex = 0;
+    this->quietIndex = 0;
+    this->killerIndex = 0;
+    this->capturesOnly = false;
+}
+
+MovePicker::MovePicker(chess::Board* position) {
+    this->position = position;
+    this->hashMove = chess::Move(chess::Move::NO_MOVE);
+    this->killers[0] = this->killers[1] = chess::Move(chess::Move::NO_MOVE);
+    this->history = nullptr;
+    this->stage = PICK_GENERATE_CAPTURES;
+    this->captureIndex = 0;
+    this->quietIndex = 0;
+    this->killerIndex = 0;
+    this->capturesOnly = true;
+}
+
+chess::Move MovePicker::next() {
+    const chess::Move noMove = chess::Move(chess::Move::NO_MOVE);
+    switch (this->stage) {
+    case PICK_GENERATE_CAPTURES:
+        chess::movegen::legalmoves<chess::movegen::MoveGenType::CAPTURE>(this->captures, *this->position);
+        this->scoreCaptures();
+
+        //A hash move can come from a different position that shares the bucket, so only trust it once it
+        //shows up in the legal moves. A quiet one means generating the quiets early.
+        if (this->hashMove != noMove && !this->contains(this->captures, 0, this->hashMove)) {
+            chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(this->quiets, *this->position);
+            this->scoreQuiets();
+            if (!this->contains(this->quiets, 0, this->hashMove)) this->hashMove = noMove;
+        }
+        this->stage = PICK_HASH_MOVE;
+        [[fallthrough]];
+
+    case PICK_HASH_MOVE:
+        this->stage = PICK_CAPTURES;
+        if (this->hashMove != noMove) return this->hashMove;
+        [[fallthrough]];
+
+    case PICK_CAPTURES:
+        while (this->captureIndex < this->captures.size()) {
+            chess::Move move = this->pickBest(this->captures, this->captureIndex);
+            if (move != this->hashMove) return move;
+        }
+        if (this->capturesOnly) {
+            this->stage = PICK_DONE;
+            break;
+        }
+        this->stage = PICK_GENERATE_QUIETS;
+        [[fallthrough]];
+
+    case PICK_GENERATE_QUIETS:
+        if (this->quiets.empty()) {
+            chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(this->quiets, *this->position);
+            this->scoreQuiets();
+        }
+        this->stage = PICK_KILLERS;
+        [[fallthrough]];
+
+    case PICK_KILLERS:
+        while (this->killerIndex < 2) {
+            chess::Move killer = this->killers[this->killerIndex++];
+            if (killer == noMove || killer == this->hashMove) continue;
+            if (this->killerIndex == 2 && killer == this->killers[0]) continue;
+            if (this->contains(this->quiets, 0, killer)) return killer;
+        }
+        this->stage = PICK_QUIETS;
+        [[fallthrough]];
+
+    case PICK_QUIETS:
+        while (this->quietIndex < this->quiets.size()) {
+            chess::Move move = this->pickBest(this->quiets, this->quietIndex);
+            if (move != this->hashMove && move != this->killers[0] && move != this->killers[1]) return move;
+        }
+        this->stage = PICK_DONE;
+        [[fallthrough]];
+
+    case PICK_DONE:
+        break;
+    }
+    return noMove;
+}
+
+chess::Move MovePicker::pickBest(chess::Movelist& moves, int& index) {
+    //one pass of selection sort: only as much sorting as the moves actually handed out need
+    int best = index;
+    for (int i = index + 1; i < moves.size(); i++) {
+        if (moves[i].score() > moves[best].score()) best = i;
+    }
+    std::swap(moves[index], moves[best]);
+    return moves[index++];
+}
+
+bool MovePicker::contains(chess::Movelist& moves, int from, chess::Move move) {
+    for (int i = from; i < moves.size(); i++) {
+        if (moves[i] == move) return true;
+    }
+    return false;
+}
+
+int16_t MovePicker::captureValue(chess::Board* position, chess::Move move) {
+    if (move.typeOf() == chess::Move::ENPASSANT) return pieceValues[int(chess::PieceType(chess::PieceType::PAWN))];
+    return pieceValues[int(position->at(move.to()).type())];
+}
+
+void MovePicker::scoreCaptures() {
+    //MVV-LVA: the most valuable victim first, and of those the cheapest attacker first
+    for (chess::Move& move : this->captures) {
+        int attacker = int(this->position->at(move.from()).type());
+        int16_t score = captureValue(this->position, move) * 16 - pieceValues[attacker];
+        if (move.typeOf() == chess::Move::PROMOTION) score += pieceValues[int(move.promotionType())] * 16;
+        move.setScore(score);
+    }
+}
+
+void MovePicker::scoreQuiets() {
+    for (chess::Move& move : this->quiets) {
+        move.setScore(this->history[move.from().index()][move.to().index()]);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+
+enum MovePickerStage {
+    PICK_GENERATE_CAPTURES,
+    PICK_HASH_MOVE,
+    PICK_CAPTURES,
+    PICK_GENERATE_QUIETS,
+    PICK_KILLERS,
+    PICK_QUIETS,
+    PICK_DONE
+};
+
+//Hands out the legal moves of a position one at a time, best guess first: the hash move, captures by
+//MVV-LVA, the killer moves of this ply, then the remaining quiet moves by history score. Quiet moves are
+//only generated once the captures have run out, and each stage picks its best remaining move when asked
+//instead of sorting the whole list, so a node that cuts off early pays for very little ordering.
+//The quiescence search only wants the captures, which is what the single-argument constructor gives.
+class MovePicker {
+    public:
+        MovePicker(chess::Board* position, chess::Move hashMove, const chess::Move* killers, const int16_t (*history)[64]);
+        MovePicker(chess::Board* position);
+        chess::Move next();
+
+        static int16_t captureValue(chess::Board* position, chess::Move move);
+
+        //getters and setters
+        MovePickerStage getStage() { return this->stage; }
+    private:
+        chess::Move pickBest(chess::Movelist& moves, int& index);
+        bool contains(chess::Movelist& moves, int from, chess::Move move);
+        void scoreCaptures();
+        void scoreQuiets();
+
+        chess::Board* position;
+        chess::Move hashMove;
+        chess::Move killers[2];
+        const int16_t (*history)[64];
+        MovePickerStage stage;
+        bool capturesOnly;
+
+        chess::Movelist captures;
+        chess::Movelist quiets;
+        int captureIndex;
+        int quietIndex;
+        int killerIndex;
+};
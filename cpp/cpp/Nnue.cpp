@@ -0,0 +1,192 @@
+#include "Nnue.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NNUE_SSE2
+#endif
+
+//Column arithmetic on the hidden layer. Everything is int16 and NNUE_HIDDEN is a multiple of 16, so the
+//loops map straight onto 16 (AVX2) or 8 (SSE2) lanes with no remainder.
+static void applyDelta(int16_t* to, const int16_t* from, const int16_t* const* adds, int addCount, const int16_t* const* subs, int subCount) {
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(from + i));
+        for (int a = 0; a < addCount; a++) v = _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i*)(adds[a] + i)));
+        for (int s = 0; s < subCount; s++) v = _mm256_sub_epi16(v, _mm256_loadu_si256((const __m256i*)(subs[s] + i)));
+        _mm256_storeu_si256((__m256i*)(to + i), v);
+    }
+#elif defined(NNUE_SSE2)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(from + i));
+        for (int a = 0; a < addCount; a++) v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(adds[a] + i)));
+        for (int s = 0; s < subCount; s++) v = _mm_sub_epi16(v, _mm_loadu_si128((const __m128i*)(subs[s] + i)));
+        _mm_storeu_si128((__m128i*)(to + i), v);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int16_t v = from[i];
+        for (int a = 0; a < addCount; a++) v += adds[a][i];
+        for (int s = 0; s < subCount; s++) v -= subs[s][i];
+        to[i] = v;
+    }
+#endif
+}
+
+//sum over the hidden layer of clamp(accumulator, 0, QA) * weight
+static int32_t clippedDot(const int16_t* accumulator, const int16_t* weights) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ceiling = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(accumulator + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), ceiling);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, _mm256_loadu_si256((const __m256i*)(weights + i))));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    return _mm_cvtsi128_si32(half);
+#elif defined(NNUE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ceiling = _mm_set1_epi16(NNUE_QA);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(accumulator + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), ceiling);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i*)(weights + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        sum += int32_t(std::clamp<int16_t>(accumulator[i], 0, NNUE_QA)) * weights[i];
+    }
+    return sum;
+#endif
+}
+
+NnueNetwork::NnueNetwork() {
+    this->loaded = false;
+    this->outputBias = 0;
+}
+
+bool NnueNetwork::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    uint32_t header[3];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || std::memcmp(magic, "CENN", 4) != 0 || header[0] != 1 || header[1] != NNUE_INPUTS || header[2] != NNUE_HIDDEN) {
+        return false;
+    }
+
+    std::vector<int16_t> featureWeights(NNUE_INPUTS * NNUE_HIDDEN);
+    std::vector<int16_t> featureBias(NNUE_HIDDEN);
+    std::vector<int16_t> outputWeights(2 * NNUE_HIDDEN);
+    int32_t outputBias;
+    in.read(reinterpret_cast<char*>(featureWeights.data()), featureWeights.size() * sizeof(int16_t));
+    in.read(reinterpret_cast<char*>(featureBias.data()), featureBias.size() * sizeof(int16_t));
+    in.read(reinterpret_cast<char*>(outputWeights.data()), outputWeights.size() * sizeof(int16_t));
+    in.read(reinterpret_cast<char*>(&outputBias), sizeof(outputBias));
+    if (!in) return false;
+
+    //only replace the current network once the whole file has been read
+    this->featureWeights = std::move(featureWeights);
+    this->featureBias = std::move(featureBias);
+    this->outputWeights = std::move(outputWeights);
+    this->outputBias = outputBias;
+    this->loaded = true;
+    return true;
+}
+
+int NnueNetwork::featureIndex(chess::Color perspective, chess::Piece piece, chess::Square square) {
+    //each side sees the board from its own end: own pieces first, ranks flipped for black
+    int relativeColor = piece.color() == perspective ? 0 : 1;
+    int relativeSquare = perspective == chess::Color::WHITE ? square.index() : square.index() ^ 56;
+    return (relativeColor * 6 + int(piece.type())) * 64 + relativeSquare;
+}
+
+void NnueNetwork::refresh(const chess::Board& board, NnueAccumulator& accumulator) const {
+    for (chess::Color perspective : {chess::Color::WHITE, chess::Color::BLACK}) {
+        int16_t* values = accumulator.values[int(perspective)];
+        std::copy(this->featureBias.begin(), this->featureBias.end(), values);
+
+        chess::Bitboard occupied = board.occ();
+        while (occupied) {
+            chess::Square square = chess::Square(occupied.pop());
+            const int16_t* column = &this->featureWeights[featureIndex(perspective, board.at(square), square) * NNUE_HIDDEN];
+            applyDelta(values, values, &column, 1, nullptr, 0);
+        }
+    }
+}
+
+void NnueNetwork::update(const NnueAccumulator& from, NnueAccumulator& to, const NnueDelta& delta) const {
+    for (chess::Color perspective : {chess::Color::WHITE, chess::Color::BLACK}) {
+        const int16_t* adds[2];
+        const int16_t* subs[2];
+        for (int i = 0; i < delta.addCount; i++) {
+            adds[i] = &this->featureWeights[featureIndex(perspective, delta.addPiece[i], delta.addSquare[i]) * NNUE_HIDDEN];
+        }
+        for (int i = 0; i < delta.subCount; i++) {
+            subs[i] = &this->featureWeights[featureIndex(perspective, delta.subPiece[i], delta.subSquare[i]) * NNUE_HIDDEN];
+        }
+        applyDelta(to.values[int(perspective)], from.values[int(perspective)], adds, delta.addCount, subs, delta.subCount);
+    }
+}
+
+int16_t NnueNetwork::evaluate(const NnueAccumulator& accumulator, chess::Color sideToMove) const {
+    int32_t output = clippedDot(accumulator.values[int(sideToMove)], &this->outputWeights[0])
+        + clippedDot(accumulator.values[int(~sideToMove)], &this->outputWeights[NNUE_HIDDEN])
+        + this->outputBias;
+
+    //network centipawns for the side to move -> engine units (a pawn is 1 << 8) for white, kept clear of mate scores
+    int64_t centipawns = int64_t(output) * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+    int64_t score = std::clamp<int64_t>(centipawns * 256 / 100, -0x7000, 0x7000);
+    return int16_t(sideToMove == chess::Color::WHITE ? score : -score);
+}
+
+NnueDelta NnueNetwork::moveDelta(const chess::Board& board, chess::Move move) {
+    NnueDelta delta;
+    chess::Color us = board.sideToMove();
+    chess::Piece moving = board.at(move.from());
+
+    auto add = [&](chess::Piece piece, chess::Square square) {
+        delta.addPiece[delta.addCount] = piece;
+        delta.addSquare[delta.addCount++] = square;
+    };
+    auto sub = [&](chess::Piece piece, chess::Square square) {
+        delta.subPiece[delta.subCount] = piece;
+        delta.subSquare[delta.subCount++] = square;
+    };
+
+    if (move.typeOf() == chess::Move::CASTLING) {
+        //castling is encoded as king takes own rook
+        bool kingSide = move.to().index() > move.from().index();
+        chess::Piece rook = board.at(move.to());
+        sub(moving, move.from());
+        sub(rook, move.to());
+        add(moving, chess::Square(chess::File(kingSide ? 6 : 2), move.from().rank()));
+        add(rook, chess::Square(chess::File(kingSide ? 5 : 3), move.from().rank()));
+        return delta;
+    }
+
+    sub(moving, move.from());
+    if (move.typeOf() == chess::Move::ENPASSANT) {
+        sub(chess::Piece(chess::PieceType::PAWN, ~us), chess::Square(move.to().file(), move.from().rank()));
+    }
+    else if (board.at(move.to()) != chess::Piece::NONE) {
+        sub(board.at(move.to()), move.to());
+    }
+    add(move.typeOf() == chess::Move::PROMOTION ? chess::Piece(move.promotionType(), us) : moving, move.to());
+    return delta;
+}
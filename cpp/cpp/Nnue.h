@@ -0,0 +1,61 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//A small efficiently updatable network: 768 inputs (colour x piece type x square, seen from one side),
+//one hidden layer of NNUE_HIDDEN clipped-ReLU neurons per side, one output.
+//
+//Each side's first layer is kept as an accumulator: the sum of the weight columns of every piece on the
+//board. A move only flips two to four inputs, so the search updates the accumulator by adding and
+//subtracting those columns instead of recomputing it, and only the small output layer runs per evaluation.
+//
+//Weights file, little-endian:
+//    char[4]  "CENN"
+//    uint32   version (1), inputs (768), hidden (NNUE_HIDDEN)
+//    int16    featureWeights[768][hidden]
+//    int16    featureBias[hidden]
+//    int16    outputWeights[2 * hidden]   side to move's half first
+//    int32    outputBias
+const int NNUE_INPUTS = 768;
+const int NNUE_HIDDEN = 256;
+const int NNUE_QA = 255;  //clipped ReLU ceiling, the quantisation of the hidden layer
+const int NNUE_QB = 64;   //quantisation of the output weights
+const int NNUE_SCALE = 400; //network output units per pawn * 100
+
+struct alignas(32) NnueAccumulator {
+    int16_t values[2][NNUE_HIDDEN]; //[perspective colour]
+};
+
+//The inputs a move switches off and on. Castling moves two pieces, everything else at most
+//one off, one off (the capture) and one on.
+struct NnueDelta {
+    int addCount = 0;
+    int subCount = 0;
+    chess::Piece addPiece[2];
+    chess::Square addSquare[2];
+    chess::Piece subPiece[2];
+    chess::Square subSquare[2];
+};
+
+class NnueNetwork {
+    public:
+        NnueNetwork();
+        bool load(const std::string& path);
+        bool isLoaded() const { return this->loaded; }
+
+        void refresh(const chess::Board& board, NnueAccumulator& accumulator) const;
+        void update(const NnueAccumulator& from, NnueAccumulator& to, const NnueDelta& delta) const;
+        int16_t evaluate(const NnueAccumulator& accumulator, chess::Color sideToMove) const;
+
+        static NnueDelta moveDelta(const chess::Board& board, chess::Move move);
+    private:
+        static int featureIndex(chess::Color perspective, chess::Piece piece, chess::Square square);
+
+        bool loaded;
+        std::vector<int16_t> featureWeights; //[input][hidden]
+        std::vector<int16_t> featureBias;
+        std::vector<int16_t> outputWeights;
+        int32_t outputBias;
+};
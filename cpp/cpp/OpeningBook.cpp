@@ -0,0 +1,87 @@
+#include "OpeningBook.h"
+
+static uint64_t readBigEndian(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) value = (value << 8) | bytes[i];
+    return value;
+}
+
+bool OpeningBook::open(const std::string& path) {
+    if (!this->file.open(path)) return false;
+    if (this->file.getSize() < BOOK_ENTRY_SIZE) {
+        this->file.close();
+        return false;
+    }
+    return true;
+}
+
+void OpeningBook::close() {
+    this->file.close();
+}
+
+uint64_t OpeningBook::keyAt(size_t index) const {
+    return readBigEndian(this->file.getData() + index * BOOK_ENTRY_SIZE, 8);
+}
+
+//Polyglot moves are to (bits 0-5), from (6-11) and promotion piece (12-14, knight = 1 .. queen = 4). Castling
+//is king takes own rook, the same as chess::Move, so matching against the legal moves covers every case and
+//also throws out a move from a position that only shares the key.
+chess::Move OpeningBook::toMove(const chess::Board& board, uint16_t polyglotMove) const {
+    int to = polyglotMove & 63;
+    int from = (polyglotMove >> 6) & 63;
+    int promotion = (polyglotMove >> 12) & 7;
+
+    chess::Movelist legalMoves;
+    chess::movegen::legalmoves(legalMoves, board);
+    for (const chess::Move& move : legalMoves) {
+        if (move.from().index() != from || move.to().index() != to) continue;
+        bool isPromotion = move.typeOf() == chess::Move::PROMOTION;
+        if (isPromotion != (promotion != 0)) continue;
+        if (isPromotion && int(move.promotionType()) != promotion) continue; //PieceType: knight = 1 .. queen = 4
+        return move;
+    }
+    return chess::Move(chess::Move::NO_MOVE);
+}
+
+chess::Move OpeningBook::probe(const chess::Board& board, BookSelection selection, uint64_t random) const {
+    if (!this->file.isOpen()) return chess::Move(chess::Move::NO_MOVE);
+    const unsigned char* data = this->file.getData();
+    size_t entryCount = this->getEntryCount();
+    uint64_t key = board.hash();
+
+    //lower bound: the first entry for this key
+    size_t low = 0, high = entryCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (this->keyAt(middle) < key) low = middle + 1;
+        else high = middle;
+    }
+
+    uint32_t totalWeight = 0;
+    size_t end = low;
+    for (; end < entryCount && this->keyAt(end) == key; end++) {
+        totalWeight += uint32_t(readBigEndian(data + end * BOOK_ENTRY_SIZE + 10, 2));
+    }
+    if (end == low) return chess::Move(chess::Move::NO_MOVE);
+
+    uint32_t pick = totalWeight > 0 ? uint32_t(random % totalWeight) : 0;
+
+    size_t chosen = low;
+    uint32_t bestWeight = 0;
+    uint32_t cumulative = 0;
+    for (size_t i = low; i < end; i++) {
+        uint32_t weight = uint32_t(readBigEndian(data + i * BOOK_ENTRY_SIZE + 10, 2));
+        if (selection == BOOK_BEST && weight > bestWeight) {
+            bestWeight = weight;
+            chosen = i;
+        }
+        if (selection == BOOK_WEIGHTED) {
+            cumulative += weight;
+            if (pick < cumulative) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+    return this->toMove(board, uint16_t(readBigEndian(data + chosen * BOOK_ENTRY_SIZE + 8, 2)));
+}
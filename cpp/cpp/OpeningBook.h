@@ -0,0 +1,36 @@
+#pragma once
+#include "chess.hpp"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+const size_t BOOK_ENTRY_SIZE = 16;
+
+enum BookSelection {
+    BOOK_BEST,    //always the most played move
+    BOOK_WEIGHTED //a move picked at random, in proportion to its weight
+};
+
+//A Polyglot opening book (.bin): 16-byte big-endian entries of key, move, weight and learn, sorted by key.
+//The keys are the Polyglot Zobrist keys chess::Board::hash() already computes.
+//
+//The file is memory-mapped read-only instead of read in, so opening it costs nothing up front, a probe is a
+//binary search straight over the mapping with no allocation, and every process using the same book shares
+//one copy of it through the page cache.
+class OpeningBook {
+    public:
+        bool open(const std::string& path);
+        void close();
+        //NO_MOVE when out of book. random picks the move under BOOK_WEIGHTED; the book itself is never written,
+        //so one book can serve any number of engines and threads.
+        chess::Move probe(const chess::Board& board, BookSelection selection, uint64_t random) const;
+
+        //getters and setters
+        bool isOpen() const { return this->file.isOpen(); }
+        size_t getEntryCount() const { return this->file.getSize() / BOOK_ENTRY_SIZE; }
+    private:
+        uint64_t keyAt(size_t index) const;
+        chess::Move toMove(const chess::Board& board, uint16_t polyglotMove) const;
+
+        MappedFile file;
+};
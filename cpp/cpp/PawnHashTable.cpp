@@ -0,0 +1,152 @@
+#include "PawnHashTable.h"
+#include <algorithm>
+#include <array>
+
+static constexpr std::array<uint64_t, 8> makeFileMasks() {
+    std::array<uint64_t, 8> masks = {};
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) masks[file] |= 1ULL << (rank * 8 + file);
+    }
+    return masks;
+}
+
+static constexpr std::array<uint64_t, 8> FILE_MASKS = makeFileMasks();
+static constexpr uint64_t NOT_FILE_A = ~FILE_MASKS[0];
+static constexpr uint64_t NOT_FILE_H = ~FILE_MASKS[7];
+static constexpr uint64_t RANK_1 = 0xffULL;
+static_assert(FILE_MASKS[0] == 0x0101010101010101ULL && FILE_MASKS[7] == 0x8080808080808080ULL, "file masks");
+
+struct PawnZobrist {
+    uint64_t keys[2][64]; //[color][square]
+};
+
+//splitmix64, at compile time so every build agrees on the keys
+static constexpr PawnZobrist makePawnZobrist() {
+    PawnZobrist zobrist = {};
+    uint64_t state = 0x70a3c5e1d2b4f687ULL;
+    for (int color = 0; color < 2; color++) {
+        for (int square = 0; square < 64; square++) {
+            state += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            zobrist.keys[color][square] = z ^ (z >> 31);
+        }
+    }
+    return zobrist;
+}
+
+static constexpr PawnZobrist pawnZobrist = makePawnZobrist();
+
+static constexpr uint64_t northFill(uint64_t b) {
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+    return b;
+}
+
+static constexpr uint64_t southFill(uint64_t b) {
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return b;
+}
+
+PawnHashTable::PawnHashTable(size_t entries) {
+    //round down to a power of two so the index is a single AND
+    size_t count = 1;
+    while (count * 2 <= entries) count *= 2;
+    this->entries = std::make_unique<PawnEntry[]>(count);
+    this->mask = count - 1;
+    this->clear();
+}
+
+PawnEntry* PawnHashTable::probe(uint64_t key, bool& found) {
+    PawnEntry* entry = &this->entries[key & this->mask];
+    found = entry->key == key;
+    return entry;
+}
+
+//a key of 0 is the no-pawns structure, so empty slots are marked with one no real structure has
+void PawnHashTable::clear() {
+    for (uint64_t i = 0; i <= this->mask; i++) {
+        this->entries[i] = PawnEntry();
+        this->entries[i].key = ~uint64_t(0);
+    }
+}
+
+uint64_t PawnHashTable::pawnKey(const chess::Board& board) {
+    uint64_t key = 0;
+    for (int color = 0; color < 2; color++) {
+        chess::Bitboard pawns = board.pieces(chess::PieceType::PAWN, chess::Color(color));
+        while (pawns) {
+            key ^= pawnZobrist.keys[color][pawns.pop()];
+        }
+    }
+    return key;
+}
+
+uint64_t PawnHashTable::pawnKeyDelta(const chess::Board& board, chess::Move move) {
+    int us = int(board.sideToMove());
+    uint64_t delta = 0;
+    if (board.at(move.from()).type() == chess::PieceType::PAWN) {
+        delta ^= pawnZobrist.keys[us][move.from().index()];
+        if (move.typeOf() != chess::Move::PROMOTION) delta ^= pawnZobrist.keys[us][move.to().index()];
+    }
+    if (move.typeOf() == chess::Move::ENPASSANT) {
+        //the pawn taken is beside the one taking, not on the square it moves to
+        delta ^= pawnZobrist.keys[1 - us][(move.from().index() & ~7) | (move.to().index() & 7)];
+    }
+    else if (move.typeOf() != chess::Move::CASTLING && board.at(move.to()).type() == chess::PieceType::PAWN) {
+        delta ^= pawnZobrist.keys[1 - us][move.to().index()];
+    }
+    return delta;
+}
+
+//Longest run of pawns on one diagonal, for both colours at once. Each step keeps only the pawns with another
+//pawn diagonally behind them, so after k steps what is left are the tips of chains longer than k, and the
+//number of steps that leave anything is the longest chain. Fixed trip count, no branches: chains can't be
+//longer than the six ranks pawns stand on.
+static void longestChains(uint64_t white, uint64_t black, int& whiteLength, int& blackLength) {
+    uint64_t whiteUp = white, blackUp = black;     //up and to the right, a1-h8 direction
+    uint64_t whiteDown = white, blackDown = black; //up and to the left, h1-a8 direction
+    int whiteUpLength = 0, blackUpLength = 0, whiteDownLength = 0, blackDownLength = 0;
+    for (int step = 0; step < 6; step++) {
+        whiteUpLength += whiteUp != 0;
+        blackUpLength += blackUp != 0;
+        whiteDownLength += whiteDown != 0;
+        blackDownLength += blackDown != 0;
+        whiteUp &= (whiteUp << 9) & NOT_FILE_A;
+        blackUp &= (blackUp << 9) & NOT_FILE_A;
+        whiteDown &= (whiteDown << 7) & NOT_FILE_H;
+        blackDown &= (blackDown << 7) & NOT_FILE_H;
+    }
+    whiteLength = std::max(whiteUpLength, whiteDownLength);
+    blackLength = std::max(blackUpLength, blackDownLength);
+}
+
+//Islands, doubled and isolated pawns come from file fills: filling a colour's pawns down the board leaves
+//the files it has pawns on along the first rank. A pawn is passed when no enemy pawn is ahead of it on its
+//own file (the enemy's front span) or could take it on the way (the enemy's attack span).
+void PawnHashTable::evaluate(uint64_t white, uint64_t black, PawnEntry& entry) {
+    int whiteChain, blackChain;
+    longestChains(white, black, whiteChain, blackChain);
+    entry.score = int16_t((2 << whiteChain) - (2 << blackChain));
+
+    uint64_t whiteAttackSpan = northFill(((white & NOT_FILE_H) << 9) | ((white & NOT_FILE_A) << 7));
+    uint64_t blackAttackSpan = southFill(((black & NOT_FILE_H) >> 7) | ((black & NOT_FILE_A) >> 9));
+    entry.attackSpan[0] = chess::Bitboard(whiteAttackSpan);
+    entry.attackSpan[1] = chess::Bitboard(blackAttackSpan);
+    entry.passed[0] = chess::Bitboard(white & ~(southFill(black >> 8) | blackAttackSpan));
+    entry.passed[1] = chess::Bitboard(black & ~(northFill(white << 8) | whiteAttackSpan));
+    entry.doubled[0] = chess::Bitboard(white & southFill(white >> 8));
+    entry.doubled[1] = chess::Bitboard(black & northFill(black << 8));
+
+    for (int color = 0; color < 2; color++) {
+        uint64_t pawns = color == 0 ? white : black;
+        uint64_t files = southFill(pawns) & RANK_1;
+        uint64_t neighbours = ((files << 1) | (files >> 1)) & RANK_1;
+        entry.isolated[color] = chess::Bitboard(pawns & ~northFill(neighbours));
+        entry.islands[color] = uint8_t(chess::Bitboard(files & ~(files << 1)).count());
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+#include <memory>
+
+const size_t PAWN_HASH_ENTRIES = 1 << 14; //per search thread, about 1 MB
+
+//Everything that depends on the pawns alone, worked out once per pawn structure. Only score goes into the
+//evaluation so far; the rest is there for the island, doubled and passed pawn terms to come, which will
+//then cost nothing on a hit.
+struct PawnEntry {
+    uint64_t key;                  //pawn key, see PawnHashTable::pawnKey
+    int16_t score;                 //pawn chains, white's point of view
+    uint8_t islands[2];            //[color] groups of pawns on neighbouring files
+    chess::Bitboard passed[2];     //[color] pawns no enemy pawn can block or take on the way up
+    chess::Bitboard isolated[2];   //[color] pawns with no friendly pawn on a neighbouring file
+    chess::Bitboard doubled[2];    //[color] pawns with a friendly pawn in front of them on the file
+    chess::Bitboard attackSpan[2]; //[color] every square the pawns attack now or could after advancing
+};
+
+//Pawn structures repeat far more than positions do: most moves don't touch a pawn, so one structure is
+//evaluated across whole subtrees. Each search thread has its own table, so there is nothing to lock, and an
+//entry is replaced whenever another structure lands in its slot.
+//
+//The pawn key is a Zobrist key over pawns only. The search keeps it in step with the board by XOR-ing in
+//pawnKeyDelta on every move and again when it is taken back, the same way the board's own hash works.
+class PawnHashTable {
+    public:
+        PawnHashTable(size_t entries = PAWN_HASH_ENTRIES);
+        PawnEntry* probe(uint64_t key, bool& found); //the slot for key, found if it already holds it
+        void clear();
+
+        static uint64_t pawnKey(const chess::Board& board);
+        static uint64_t pawnKeyDelta(const chess::Board& board, chess::Move move); //board before the move
+        static void evaluate(uint64_t whitePawns, uint64_t blackPawns, PawnEntry& entry); //everything but key
+    private:
+        std::unique_ptr<PawnEntry[]> entries;
+        uint64_t mask;
+};
@@ -0,0 +1,143 @@
+#include "SearchStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+void SearchCounters::clear() {
+    this->leafEvals = 0;
+    this->quiescenceNodes = 0;
+    this->betaCutoffs = 0;
+    this->alphaCutoffs = 0;
+    std::fill(this->cutoffsByMoveIndex, this->cutoffsByMoveIndex + STATS_CUTOFF_SLOTS, uint64_t(0));
+    this->ttProbes = 0;
+    this->ttHits = 0;
+    this->ttCutoffs = 0;
+    this->nullMoveTries = 0;
+    this->nullMoveCutoffs = 0;
+    this->lateMovePrunes = 0;
+    this->lmrReductions = 0;
+    this->researches = 0;
+    this->aspirationResearches = 0;
+    this->bitbaseHits = 0;
+    this->pawnHashProbes = 0;
+    this->pawnHashHits = 0;
+    this->rootMinScore = INT32_MAX;
+    this->rootMaxScore = INT32_MIN;
+}
+
+void SearchCounters::addCutoff(int moveIndex, bool whiteToMove) {
+    if (whiteToMove) this->betaCutoffs++;
+    else this->alphaCutoffs++;
+    this->cutoffsByMoveIndex[std::min(moveIndex, STATS_CUTOFF_SLOTS - 1)]++;
+}
+
+void SearchCounters::addRootScore(int32_t score) {
+    this->rootMinScore = std::min(this->rootMinScore, score);
+    this->rootMaxScore = std::max(this->rootMaxScore, score);
+}
+
+void SearchStats::add(const SearchCounters& counters) {
+    this->leafEvals += counters.leafEvals;
+    this->quiescenceNodes += counters.quiescenceNodes;
+    this->betaCutoffs += counters.betaCutoffs;
+    this->alphaCutoffs += counters.alphaCutoffs;
+    for (int i = 0; i < STATS_CUTOFF_SLOTS; i++) {
+        this->cutoffsByMoveIndex[i] += counters.cutoffsByMoveIndex[i];
+    }
+    this->ttProbes += counters.ttProbes;
+    this->ttHits += counters.ttHits;
+    this->ttCutoffs += counters.ttCutoffs;
+    this->nullMoveTries += counters.nullMoveTries;
+    this->nullMoveCutoffs += counters.nullMoveCutoffs;
+    this->lateMovePrunes += counters.lateMovePrunes;
+    this->lmrReductions += counters.lmrReductions;
+    this->researches += counters.researches;
+    this->aspirationResearches += counters.aspirationResearches;
+    this->bitbaseHits += counters.bitbaseHits;
+    this->pawnHashProbes += counters.pawnHashProbes;
+    this->pawnHashHits += counters.pawnHashHits;
+}
+
+double SearchStats::nodesPerSecond() const {
+    return this->timeMs > 0 ? this->nodes / this->timeMs * 1000 : 0;
+}
+
+double SearchStats::branchingFactor() const {
+    //the Python logger's definition: the per-ply factor that would give this many nodes at this depth
+    if (this->nodes <= 1 || this->depth <= 0) return 0;
+    return std::pow(double(this->nodes), 1.0 / this->depth);
+}
+
+double SearchStats::firstMoveCutoffRate() const {
+    uint64_t cutoffs = this->betaCutoffs + this->alphaCutoffs;
+    return cutoffs > 0 ? double(this->cutoffsByMoveIndex[0]) / cutoffs : 0;
+}
+
+//local time the way Python's datetime.now().isoformat() prints it
+static std::string isoTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000;
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    std::ostringstream out;
+    out << std::put_time(&local, "%Y-%m-%dT%H:%M:%S") << "." << std::setw(6) << std::setfill('0') << micros;
+    return out.str();
+}
+
+//engine units are 1 << 8 per pawn, the Python engine scores in pawns
+static double pawns(int32_t score) {
+    return score / 256.0;
+}
+
+SearchStatsLogger::SearchStatsLogger(const std::string& path, StatsFormat format) {
+    this->format = format;
+    this->out.open(path, std::ios::app);
+    if (this->format == STATS_CSV && this->out.is_open() && this->out.tellp() == 0) {
+        this->out << "timestamp,depth,positions_evaluated,positions_skipped,time_taken_ms,move_san,color,branching_factor,"
+            "nodes_per_second,best_score,min_score,max_score,alpha_prunes,beta_prunes,total_prunes" << std::endl;
+    }
+}
+
+void SearchStatsLogger::log(const SearchStats& stats, const std::string& moveSan, chess::Color color) {
+    if (!this->out.is_open()) return;
+    const char* colorName = color == chess::Color::WHITE ? "white" : "black";
+    this->out << std::fixed << std::setprecision(2);
+
+    if (this->format == STATS_CSV) {
+        this->out << isoTimestamp() << "," << stats.depth << "," << stats.nodes << "," << stats.ttCutoffs << ","
+            << stats.timeMs << "," << moveSan << "," << colorName << "," << stats.branchingFactor() << ","
+            << stats.nodesPerSecond() << "," << pawns(stats.bestScore) << "," << pawns(stats.minScore) << ","
+            << pawns(stats.maxScore) << "," << stats.alphaCutoffs << "," << stats.betaCutoffs << ","
+            << stats.alphaCutoffs + stats.betaCutoffs << std::endl;
+        return;
+    }
+
+    this->out << "{\"timestamp\":\"" << isoTimestamp() << "\",\"depth\":" << stats.depth
+        << ",\"positions_evaluated\":" << stats.nodes << ",\"positions_skipped\":" << stats.ttCutoffs
+        << ",\"time_taken_ms\":" << stats.timeMs << ",\"move_san\":\"" << moveSan << "\",\"color\":\"" << colorName
+        << "\",\"branching_factor\":" << stats.branchingFactor() << ",\"nodes_per_second\":" << stats.nodesPerSecond()
+        << ",\"best_score\":" << pawns(stats.bestScore) << ",\"min_score\":" << pawns(stats.minScore)
+        << ",\"max_score\":" << pawns(stats.maxScore) << ",\"alpha_prunes\":" << stats.alphaCutoffs
+        << ",\"beta_prunes\":" << stats.betaCutoffs << ",\"total_prunes\":" << stats.alphaCutoffs + stats.betaCutoffs
+        << ",\"leaf_evals\":" << stats.leafEvals << ",\"quiescence_nodes\":" << stats.quiescenceNodes
+        << ",\"tt_probes\":" << stats.ttProbes << ",\"tt_hits\":" << stats.ttHits
+        << ",\"null_move_tries\":" << stats.nullMoveTries << ",\"null_move_cutoffs\":" << stats.nullMoveCutoffs
+        << ",\"late_move_prunes\":" << stats.lateMovePrunes << ",\"lmr_reductions\":" << stats.lmrReductions
+        << ",\"researches\":" << stats.researches << ",\"aspiration_researches\":" << stats.aspirationResearches
+        << ",\"bitbase_hits\":" << stats.bitbaseHits
+        << ",\"pawn_hash_probes\":" << stats.pawnHashProbes << ",\"pawn_hash_hits\":" << stats.pawnHashHits
+        << ",\"first_move_cutoff_rate\":" << stats.firstMoveCutoffRate()
+        << ",\"cutoffs_by_move_index\":[";
+    for (int i = 0; i < STATS_CUTOFF_SLOTS; i++) {
+        this->out << (i > 0 ? "," : "") << stats.cutoffsByMoveIndex[i];
+    }
+    this->out << "]}" << std::endl;
+}
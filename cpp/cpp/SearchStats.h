@@ -0,0 +1,88 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+const int STATS_CUTOFF_SLOTS = 8; //cutoffs on the 1st, 2nd, ... 7th move searched, then all later moves together
+
+//What one search thread counted. Only the owning thread ever writes these, so they are plain increments
+//rather than atomics, and they are only summed once the threads have joined. The alignment keeps each
+//thread's counters on cache lines of their own.
+struct alignas(64) SearchCounters {
+    uint64_t leafEvals;       //static evaluations, i.e. quiescence stand-pats
+    uint64_t quiescenceNodes;
+    uint64_t betaCutoffs;     //white refuted black's last move: score >= beta
+    uint64_t alphaCutoffs;    //black refuted white's last move: score <= alpha
+    uint64_t cutoffsByMoveIndex[STATS_CUTOFF_SLOTS];
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t ttCutoffs;       //hits deep enough to answer the node outright
+    uint64_t nullMoveTries;
+    uint64_t nullMoveCutoffs;
+    uint64_t lateMovePrunes;  //quiet moves skipped by late-move pruning
+    uint64_t lmrReductions;   //moves first searched at a reduced depth
+    uint64_t researches;      //zero-window or reduced searches that beat alpha and were searched again
+    uint64_t aspirationResearches; //root searches repeated because the score fell outside the aspiration window
+    uint64_t bitbaseHits;     //nodes answered by a bitbase
+    uint64_t pawnHashProbes;
+    uint64_t pawnHashHits;
+    int32_t rootMinScore;     //over every root move score the thread finished
+    int32_t rootMaxScore;
+
+    void clear();
+    void addCutoff(int moveIndex, bool whiteToMove);
+    void addRootScore(int32_t score);
+};
+
+//One finished search, all threads added up. The same numbers python/performance_logger.py writes.
+struct SearchStats {
+    int depth = 0;  //deepest iteration the main thread finished
+    double timeMs = 0;
+    uint64_t nodes = 0;
+    int32_t bestScore = 0; //a Score, see ChessEngine.h
+    int32_t minScore = 0;
+    int32_t maxScore = 0;
+    uint64_t leafEvals = 0;
+    uint64_t quiescenceNodes = 0;
+    uint64_t betaCutoffs = 0;
+    uint64_t alphaCutoffs = 0;
+    uint64_t cutoffsByMoveIndex[STATS_CUTOFF_SLOTS] = {};
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t ttCutoffs = 0;
+    uint64_t nullMoveTries = 0;
+    uint64_t nullMoveCutoffs = 0;
+    uint64_t lateMovePrunes = 0;
+    uint64_t lmrReductions = 0;
+    uint64_t researches = 0;
+    uint64_t aspirationResearches = 0;
+    uint64_t bitbaseHits = 0;
+    uint64_t pawnHashProbes = 0;
+    uint64_t pawnHashHits = 0;
+
+    void add(const SearchCounters& counters);
+    double nodesPerSecond() const;
+    double branchingFactor() const;
+    double firstMoveCutoffRate() const; //share of cutoffs made by the first move searched, a measure of move ordering
+};
+
+enum StatsFormat {
+    STATS_CSV,
+    STATS_JSON
+};
+
+//Appends one record per search to a file. CSV has exactly the columns of python/performance_logger.py, with
+//scores in pawns from white's point of view like the Python engine, so the same dashboards read both.
+//JSON writes one object per line with the same keys first, followed by the counters the Python engine doesn't have.
+class SearchStatsLogger {
+    public:
+        SearchStatsLogger(const std::string& path, StatsFormat format);
+        void log(const SearchStats& stats, const std::string& moveSan, chess::Color color);
+
+        //getters and setters
+        bool isOpen() { return this->out.is_open(); }
+    private:
+        std::ofstream out;
+        StatsFormat format;
+};
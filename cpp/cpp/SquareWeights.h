@@ -0,0 +1,22 @@
+#pragma once
+#include "chess.hpp"
+#include <cstdint>
+
+//Every square is worth 2 to whoever attacks it, 3 in the ring around the centre and 4 in the centre:
+//    2 2 2 2 2 2 2 2
+//    2 2 2 2 2 2 2 2
+//    2 2 3 3 3 3 2 2
+//    2 2 3 4 4 3 2 2
+//    2 2 3 4 4 3 2 2
+//    2 2 3 3 3 3 2 2
+//    2 2 2 2 2 2 2 2
+//    2 2 2 2 2 2 2 2
+//That is 2 everywhere, +1 inside c3-f6 and another +1 inside d4-e5, so an attack set is worth
+//2 * popcount(attacks) + popcount(attacks & EXTENDED_CENTER) + popcount(attacks & CENTER).
+//ChessEngine's positional control and the batched evaluation both weigh squares with these.
+const uint64_t CENTER = 0x0000001818000000ULL;
+const uint64_t EXTENDED_CENTER = 0x00003C3C3C3C0000ULL;
+
+inline int16_t weighSquares(chess::Bitboard attacks) {
+    return 2 * attacks.count() + (attacks & EXTENDED_CENTER).count() + (attacks & CENTER).count();
+}
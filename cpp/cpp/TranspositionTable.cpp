@@ -0,0 +1,97 @@
+#include "TranspositionTable.h"
+#include <algorithm>
+
+TranspositionTable::TranspositionTable(size_t sizeMB) {
+    this->generation = 0;
+    this->resize(sizeMB);
+}
+
+void TranspositionTable::resize(size_t sizeMB) {
+    //round down to a power of two so the bucket index is a single AND
+    size_t bucketCount = 1;
+    size_t bytes = std::max<size_t>(sizeMB, 1) * 1024 * 1024;
+    while (bucketCount * 2 * sizeof(TTBucket) <= bytes) bucketCount *= 2;
+
+    this->buckets.reset(new TTBucket[bucketCount]);
+    this->bucketCount = bucketCount;
+    this->bucketMask = bucketCount - 1;
+    this->clear();
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < this->bucketCount; i++) {
+        for (TTSlot& slot : this->buckets[i].slots) {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    this->generation = 0;
+}
+
+void TranspositionTable::newSearch() {
+    this->generation = (this->generation + 1) & 0x3f;
+}
+
+uint64_t TranspositionTable::pack(const TTEntry& entry) {
+    return uint64_t(entry.move)
+        | uint64_t(uint32_t(entry.score)) << 16
+        | uint64_t(uint8_t(entry.depth)) << 48
+        | uint64_t(entry.genBound) << 56;
+}
+
+TTEntry TranspositionTable::unpack(uint64_t key, uint64_t data) {
+    return TTEntry{ key, uint16_t(data), int32_t(uint32_t(data >> 16)), int8_t(uint8_t(data >> 48)), uint8_t(data >> 56) };
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+    const TTBucket& bucket = this->buckets[key & this->bucketMask];
+    for (const TTSlot& slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data != 0) {
+            entry = unpack(key, data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, TTBound bound, int32_t score, chess::Move bestMove) {
+    TTBucket& bucket = this->buckets[key & this->bucketMask];
+
+    //Same position goes back in its old slot. Otherwise evict the entry that is worth the least:
+    //shallow entries first, and entries left over from earlier searches count as shallower than they are.
+    TTSlot* replace = &bucket.slots[0];
+    TTEntry old = TTEntry{ 0, chess::Move::NO_MOVE, 0, 0, TT_NONE };
+    int replaceValue = 0x7fff;
+    for (TTSlot& slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t slotKey = slot.check.load(std::memory_order_relaxed) ^ data;
+        TTEntry candidate = unpack(slotKey, data);
+        if (slotKey == key || candidate.bound() == TT_NONE) {
+            replace = &slot;
+            old = candidate;
+            break;
+        }
+        int age = (this->generation - candidate.generation()) & 0x3f;
+        int value = candidate.depth - 4 * age;
+        if (value < replaceValue) {
+            replaceValue = value;
+            replace = &slot;
+            old = candidate;
+        }
+    }
+
+    //don't let a shallower search of the same position throw away a deeper result
+    if (old.key == key && old.bound() != TT_NONE && old.generation() == this->generation
+        && depth < old.depth && bound != TT_EXACT) {
+        return;
+    }
+
+    TTEntry entry = TTEntry{ key, bestMove.move(), score, int8_t(depth), uint8_t(uint8_t(this->generation << 2) | bound) };
+    if (entry.move == chess::Move::NO_MOVE && old.key == key) entry.move = old.move;
+
+    uint64_t data = pack(entry);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
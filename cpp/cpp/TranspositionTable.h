@@ -0,0 +1,60 @@
+#pragma once
+#include "chess.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+enum TTBound : uint8_t {
+    TT_NONE,
+    TT_UPPER, //score <= alpha: the real score is at most this
+    TT_LOWER, //score >= beta: the real score is at least this
+    TT_EXACT
+};
+
+//What a probe hands back. Not what is stored, see TTSlot.
+struct TTEntry {
+    uint64_t key;
+    uint16_t move;
+    int32_t score; //a Score, mates counted from the node that stored it
+    int8_t depth;
+    uint8_t genBound; //generation in the top 6 bits, TTBound in the bottom 2
+
+    TTBound bound() const { return TTBound(this->genBound & 0x3); }
+    uint8_t generation() const { return this->genBound >> 2; }
+};
+
+//The table is shared by every search thread without locks. Each slot keeps the packed entry and
+//key ^ packed entry; a slot torn by two threads writing at once fails the key check on probe and is
+//treated as a miss instead of handing back another position's score.
+struct TTSlot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+};
+
+//16 bytes a slot, four of them fill one 64-byte cache line
+struct alignas(64) TTBucket {
+    static const int ENTRIES = 4;
+    TTSlot slots[ENTRIES];
+};
+
+class TranspositionTable {
+    public:
+        TranspositionTable(size_t sizeMB);
+        void resize(size_t sizeMB);
+        void clear();
+        void newSearch();
+
+        bool probe(uint64_t key, TTEntry& entry) const;
+        void store(uint64_t key, int depth, TTBound bound, int32_t score, chess::Move bestMove);
+
+        //getters and setters
+        size_t getSizeMB() const { return this->bucketCount * sizeof(TTBucket) / (1024 * 1024); }
+    private:
+        static uint64_t pack(const TTEntry& entry);
+        static TTEntry unpack(uint64_t key, uint64_t data);
+
+        std::unique_ptr<TTBucket[]> buckets;
+        size_t bucketCount;
+        uint64_t bucketMask;
+        uint8_t generation;
+};
@@ -0,0 +1,347 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cctype>
+#include "chess.hpp"
+#include "ChessEngine.h"
+
+//Offline analysis of any number of positions. FEN or EPD lines stream in from the files given, or stdin, and
+//come out as one JSON line each, in input order, on stdout:
+//    {"index":0,"id":"<EPD id, if any>","fen":"..","bestmove":"e2e4","score":<centipawns for white>,
+//     "depth":..,"nodes":..,"timeMs":..,"pv":["e2e4",..],"lines":[{"move":..,"score":..,"pv":[..]},..]}
+//with "mate":<moves, positive when white mates> in place of "score" when there is one, "bestmove":null when the
+//game is already over, no score at all when a limit stopped the search before it finished a single ply (the
+//move is then just a legal one), "lines" only with --multipv above 1, and {"index":..,"fen":..,"error":".."}
+//for lines that aren't a position. A summary goes to stderr at the end.
+//
+//Each worker has its own ChessEngine and board, single-threaded: positions are independent, so running them
+//side by side scales better than splitting each one between threads. The reader deals positions round robin
+//onto the workers' own queues and a worker that runs out steals from the back of another's, so a few slow
+//positions on one queue don't leave the rest of the pool idle. Finished results wait in a reorder buffer
+//until everything before them is written. Only a window of positions is ever between the reader and the
+//output, queued, running or waiting to be written, so memory stays flat however long the input is; the reader
+//waits when the window is full, the workers never do.
+//
+//usage: batch_analyse [--depth <plies>] [--movetime <ms>] [--nodes <n>] [--threads <n>] [--hash <MB>] [--multipv <k>] [--window <positions>] [files...]
+//    limits apply per position; with none given the search goes to --depth 8
+//    files are read in order, "-" or no files at all reads stdin, e.g. batch_analyse ../../FENs/*.fen > out.jsonl
+
+const int ANALYSE_BEAM_WIDTH = 12;
+const int DEFAULT_DEPTH = 8;
+const int WINDOW_PER_WORKER = 16; //positions in flight per worker, enough to keep every worker busy behind a slow one
+
+struct AnalysisSettings {
+	SearchLimits limits; //deadline is a duration from the start of each position, see moveTime
+	std::chrono::milliseconds moveTime = std::chrono::milliseconds(0);
+	int hashSizeMB = 16;
+	int multiPv = 1;
+};
+
+struct AnalysisJob {
+	uint64_t index; //position in the input, results are written in this order
+	std::string fen;
+	std::string id;
+	bool valid;
+};
+
+//A worker's own queue. The owner takes from the front, thieves from the back, so they rarely want the same end.
+struct WorkerQueue {
+	std::deque<AnalysisJob> jobs;
+	std::mutex mutex;
+};
+
+class AnalysisPool {
+	public:
+		AnalysisPool(int workers, size_t window, const AnalysisSettings& settings, std::ostream& out);
+		void submit(AnalysisJob job); //waits while the window is full
+		void finish(); //analyses everything submitted, writes it and stops the workers
+		uint64_t getNodes() { return this->nodes; }
+	private:
+		void work(int worker);
+		bool takeJob(int worker, AnalysisJob& job);
+		std::string analyse(ChessEngine& engine, chess::Board& board, const AnalysisJob& job);
+		void complete(uint64_t index, std::string result);
+
+		AnalysisSettings settings;
+		size_t window;
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+		std::atomic<size_t> queued;
+		std::mutex idleMutex; //guards inputDone, and increments of queued so no wake-up is missed
+		std::condition_variable workReady;
+		bool inputDone;
+
+		std::ostream& out;
+		std::mutex outputMutex;
+		std::condition_variable windowOpen;
+		std::map<uint64_t, std::string> finished; //the reorder buffer, everything after nextToWrite that is done
+		uint64_t nextToWrite;
+		std::atomic<uint64_t> nodes;
+		std::vector<std::thread> workers;
+};
+
+AnalysisPool::AnalysisPool(int workers, size_t window, const AnalysisSettings& settings, std::ostream& out) : out(out) {
+	this->settings = settings;
+	this->window = std::max(window, size_t(1));
+	this->queued = 0;
+	this->inputDone = false;
+	this->nextToWrite = 0;
+	this->nodes = 0;
+	for (int i = 0; i < workers; i++) {
+		this->queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	for (int i = 0; i < workers; i++) {
+		this->workers.emplace_back([this, i]() { this->work(i); });
+	}
+}
+
+void AnalysisPool::submit(AnalysisJob job) {
+	{
+		std::unique_lock<std::mutex> lock(this->outputMutex);
+		this->windowOpen.wait(lock, [this, &job]() { return job.index < this->nextToWrite + this->window; });
+	}
+	WorkerQueue& queue = *this->queues[job.index % this->queues.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->idleMutex);
+		this->queued++;
+	}
+	this->workReady.notify_one();
+}
+
+void AnalysisPool::finish() {
+	{
+		std::lock_guard<std::mutex> lock(this->idleMutex);
+		this->inputDone = true;
+	}
+	this->workReady.notify_all();
+	//workers only stop once every queue is empty, and a result is written as soon as its turn comes
+	for (std::thread& worker : this->workers) {
+		worker.join();
+	}
+	this->out.flush();
+}
+
+void AnalysisPool::work(int worker) {
+	chess::Board board;
+	ChessEngine engine(&board, DEFAULT_DEPTH, ANALYSE_BEAM_WIDTH, 1, this->settings.hashSizeMB);
+	//analysis wants the evaluation itself, noise is only there to vary games
+	engine.setEvalNoise(NOISE_OFF);
+	engine.setMultiPv(this->settings.multiPv);
+
+	while (true) {
+		AnalysisJob job;
+		if (!this->takeJob(worker, job)) {
+			std::unique_lock<std::mutex> lock(this->idleMutex);
+			this->workReady.wait(lock, [this]() { return this->queued > 0 || this->inputDone; });
+			if (this->queued == 0 && this->inputDone) return;
+			continue;
+		}
+		this->complete(job.index, this->analyse(engine, board, job));
+	}
+}
+
+//own queue first, oldest job first; then the newest job of the next worker along that has any
+bool AnalysisPool::takeJob(int worker, AnalysisJob& job) {
+	int count = int(this->queues.size());
+	for (int i = 0; i < count; i++) {
+		WorkerQueue& queue = *this->queues[(worker + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) continue;
+		if (i == 0) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		else {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		this->queued--;
+		return true;
+	}
+	return false;
+}
+
+std::string jsonEscape(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		if (c >= ' ') escaped += c;
+	}
+	return escaped;
+}
+
+//white's point of view, like the server's replies: centipawns, or moves to mate when there is one
+std::string jsonScore(Score score) {
+	if (std::abs(score) >= SCORE_MATE_BOUND) {
+		int moves = (SCORE_MATE - std::abs(score) + 1) / 2;
+		return "\"mate\":" + std::to_string(score > 0 ? moves : -moves);
+	}
+	return "\"score\":" + std::to_string(score * 100 / 256);
+}
+
+std::string jsonMoves(const std::vector<chess::Move>& moves) {
+	std::string list = "[";
+	for (size_t i = 0; i < moves.size(); i++) {
+		list += (i > 0 ? ",\"" : "\"") + chess::uci::moveToUci(moves[i]) + "\"";
+	}
+	return list + "]";
+}
+
+std::string AnalysisPool::analyse(ChessEngine& engine, chess::Board& board, const AnalysisJob& job) {
+	std::string result = "{\"index\":" + std::to_string(job.index);
+	if (!job.id.empty()) result += ",\"id\":\"" + jsonEscape(job.id) + "\"";
+	result += ",\"fen\":\"" + jsonEscape(job.fen) + "\"";
+	if (!job.valid) return result + ",\"error\":\"not a position\"}";
+
+	//the engine searches the board it was made with, so each position is copied into it
+	board = chess::Board(job.fen);
+	if (board.pieces(chess::PieceType::KING, chess::Color::WHITE).count() != 1 || board.pieces(chess::PieceType::KING, chess::Color::BLACK).count() != 1) {
+		return result + ",\"error\":\"needs one king a side\"}";
+	}
+	SearchLimits limits = this->settings.limits;
+	auto start = std::chrono::steady_clock::now();
+	if (this->settings.moveTime.count() > 0) limits.deadline = start + this->settings.moveTime;
+	chess::Move best = engine.getBestMove(limits);
+	const std::vector<RootLine>& lines = engine.getRootLines();
+	auto timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	this->nodes += engine.getNodes();
+
+	chess::Movelist legalMoves;
+	chess::movegen::legalmoves(legalMoves, board);
+	if (legalMoves.empty()) {
+		//mate or stalemate already, the search only has a score for it
+		result += ",\"bestmove\":null," + jsonScore(engine.getSearchStats().bestScore);
+	}
+	else if (lines.empty()) {
+		//stopped before the first ply finished, the move is only the fallback getBestMove gives
+		result += ",\"bestmove\":\"" + chess::uci::moveToUci(best) + "\"";
+	}
+	else {
+		result += ",\"bestmove\":\"" + chess::uci::moveToUci(lines[0].move) + "\"," + jsonScore(lines[0].score);
+	}
+	result += ",\"depth\":" + std::to_string(engine.getCompletedDepth())
+		+ ",\"nodes\":" + std::to_string(engine.getNodes())
+		+ ",\"timeMs\":" + std::to_string(timeMs)
+		+ ",\"pv\":" + jsonMoves(!lines.empty() ? lines[0].pv : legalMoves.empty() ? std::vector<chess::Move>() : std::vector<chess::Move>{ best });
+	if (this->settings.multiPv > 1) {
+		result += ",\"lines\":[";
+		for (size_t i = 0; i < lines.size(); i++) {
+			result += std::string(i > 0 ? "," : "") + "{\"move\":\"" + chess::uci::moveToUci(lines[i].move) + "\"," + jsonScore(lines[i].score)
+				+ ",\"depth\":" + std::to_string(lines[i].depth) + ",\"pv\":" + jsonMoves(lines[i].pv) + "}";
+		}
+		result += "]";
+	}
+	return result + "}";
+}
+
+//Writes whatever is now next in line; anything finished out of turn waits in the buffer for the one before it.
+void AnalysisPool::complete(uint64_t index, std::string result) {
+	std::lock_guard<std::mutex> lock(this->outputMutex);
+	this->finished.emplace(index, std::move(result));
+	bool wrote = false;
+	while (!this->finished.empty() && this->finished.begin()->first == this->nextToWrite) {
+		this->out << this->finished.begin()->second << '\n';
+		this->finished.erase(this->finished.begin());
+		this->nextToWrite++;
+		wrote = true;
+	}
+	if (wrote) {
+		this->out.flush();
+		this->windowOpen.notify_one();
+	}
+}
+
+//FEN lines hold the position and the move counters; EPD lines only the first four FEN fields, then opcodes,
+//of which only id is kept. Blank lines and # comments aren't positions and don't take an index.
+bool parseLine(const std::string& line, AnalysisJob& job) {
+	std::istringstream fields(line);
+	std::vector<std::string> parts;
+	std::string part;
+	while (fields >> part) parts.push_back(part);
+	if (parts.empty() || parts[0][0] == '#') return false;
+
+	job.valid = parts.size() >= 4;
+	if (!job.valid) {
+		job.fen = line;
+		return true;
+	}
+	job.fen = parts[0] + " " + parts[1] + " " + parts[2] + " " + parts[3];
+	bool hasCounters = parts.size() >= 6 && std::isdigit(parts[4][0]) && std::isdigit(parts[5][0]);
+	job.fen += hasCounters ? " " + parts[4] + " " + parts[5] : " 0 1";
+	//anything chess::Board can't take is reported instead of reaching it
+	job.valid = ChessEngine::isValidFen(job.fen);
+
+	size_t id = line.find(" id \"");
+	if (id != std::string::npos) {
+		size_t close = line.find('"', id + 5);
+		if (close != std::string::npos) job.id = line.substr(id + 5, close - id - 5);
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	AnalysisSettings settings;
+	int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+	size_t window = 0;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--depth" && i + 1 < argc) settings.limits.depth = std::stoi(argv[++i]);
+		else if (arg == "--movetime" && i + 1 < argc) settings.moveTime = std::chrono::milliseconds(std::stoll(argv[++i]));
+		else if (arg == "--nodes" && i + 1 < argc) settings.limits.nodes = std::stoull(argv[++i]);
+		else if (arg == "--threads" && i + 1 < argc) threads = std::max(1, std::stoi(argv[++i]));
+		else if (arg == "--hash" && i + 1 < argc) settings.hashSizeMB = std::max(1, std::stoi(argv[++i]));
+		else if (arg == "--multipv" && i + 1 < argc) settings.multiPv = std::max(1, std::stoi(argv[++i]));
+		else if (arg == "--window" && i + 1 < argc) window = std::stoul(argv[++i]);
+		else files.push_back(arg);
+	}
+	if (settings.limits.depth == 0 && settings.moveTime.count() == 0 && settings.limits.nodes == 0) settings.limits.depth = DEFAULT_DEPTH;
+	if (window == 0) window = size_t(threads) * WINDOW_PER_WORKER;
+	if (files.empty()) files.push_back("-");
+
+	//the results are the output, so stdout is left to them
+	std::ios::sync_with_stdio(false);
+	auto start = std::chrono::steady_clock::now();
+	AnalysisPool pool(threads, window, settings, std::cout);
+	uint64_t index = 0;
+	int status = 0;
+	for (const std::string& file : files) {
+		std::ifstream in;
+		if (file != "-") {
+			in.open(file);
+			if (!in) {
+				std::cerr << "could not open " << file << std::endl;
+				status = 1;
+				continue;
+			}
+		}
+		std::istream& input = file == "-" ? std::cin : in;
+		std::string line;
+		while (std::getline(input, line)) {
+			AnalysisJob job;
+			if (!parseLine(line, job)) continue;
+			job.index = index++;
+			pool.submit(std::move(job));
+		}
+	}
+	pool.finish();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << index << " positions, " << pool.getNodes() << " nodes in " << seconds << " s ("
+		<< (seconds > 0 ? index / seconds : 0) << " positions/s, " << threads << " workers)" << std::endl;
+	return status;
+}
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include "chess.hpp"
+#include "ChessEngine.h"
+#include "GameTree.h"
+
+//Headless throughput benchmark. Runs perft (move generation only) and a fixed-depth search over a built-in
+//position set plus every position in the FENs directory, then prints total nodes, nodes/s and a signature
+//hashed from every per-position node count. Two builds that print the same signature generated and
+//searched exactly the same trees.
+//
+//usage: bench [perftDepth] [searchDepth] [threads] [--no-bulk] [--fens <dir>] [--nnue <weights>] [--stats <file>] [--bitbases <dir>] [--game-tree]
+//    threads only splits perft at the root; the search always runs single-threaded so it stays repeatable
+//    --nnue searches with the network evaluation instead of the classical one
+//    --stats appends one performance record per searched position, JSON lines if the file ends in .json, CSV otherwise
+//    --bitbases probes the tables bitbase_gen wrote there; it changes the trees, so the signature changes too
+//    --game-tree also plays a few moves from each position on a GameTree and compares each search of the tree the
+//    last move left behind with the same search on an empty one; it leaves the signature alone
+
+const std::vector<std::string> benchPositions = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+const uint32_t BENCH_SEED = 0x5eed;
+const int BENCH_BEAM_WIDTH = 12;
+const int GAME_TREE_PLIES = 4; //moves played on from each position with --game-tree
+
+uint64_t perft(chess::Board& board, int depth, bool bulk) {
+	if (depth == 0) return 1;
+	chess::Movelist moves;
+	chess::movegen::legalmoves(moves, board);
+	//bulk counting: the number of legal moves one ply from the bottom is the leaf count, no need to make them
+	if (bulk && depth == 1) return moves.size();
+
+	uint64_t nodes = 0;
+	for (const chess::Move& move : moves) {
+		board.makeMove(move);
+		nodes += perft(board, depth - 1, bulk);
+		board.unmakeMove(move);
+	}
+	return nodes;
+}
+
+//Splits the root moves between threads. Each thread takes the next unclaimed root move, on its own board.
+uint64_t parallelPerft(const chess::Board& root, int depth, bool bulk, int threads) {
+	if (depth <= 1 || threads <= 1) {
+		chess::Board board = root;
+		return perft(board, depth, bulk);
+	}
+
+	chess::Movelist rootMoves;
+	chess::movegen::legalmoves(rootMoves, root);
+	std::atomic<int> nextMove(0);
+	std::atomic<uint64_t> nodes(0);
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.emplace_back([&]() {
+			chess::Board board = root;
+			uint64_t counted = 0;
+			for (int m = nextMove++; m < rootMoves.size(); m = nextMove++) {
+				board.makeMove(rootMoves[m]);
+				counted += perft(board, depth - 1, bulk);
+				board.unmakeMove(rootMoves[m]);
+			}
+			nodes += counted;
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	return nodes;
+}
+
+//FEN files hold one position per line. EPD lines only carry the first four FEN fields, followed by opcodes.
+std::vector<std::string> loadFenDirectory(const std::string& directory) {
+	std::vector<std::string> fens;
+	std::error_code error;
+	if (!std::filesystem::is_directory(directory, error)) return fens;
+
+	std::vector<std::filesystem::path> files;
+	for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+		std::string extension = file.path().extension().string();
+		if (extension == ".fen" || extension == ".epd") files.push_back(file.path());
+	}
+	//directory order is up to the filesystem, and the signature depends on the order
+	std::sort(files.begin(), files.end());
+
+	for (const std::filesystem::path& path : files) {
+		std::ifstream in(path);
+		std::string line;
+		while (std::getline(in, line)) {
+			std::istringstream fields(line);
+			std::vector<std::string> parts;
+			std::string part;
+			while (fields >> part) parts.push_back(part);
+			if (parts.size() < 4) continue;
+
+			std::string fen = parts[0] + " " + parts[1] + " " + parts[2] + " " + parts[3];
+			bool hasCounters = parts.size() >= 6 && std::isdigit(parts[4][0]) && std::isdigit(parts[5][0]);
+			fen += hasCounters ? " " + parts[4] + " " + parts[5] : " 0 1";
+			fens.push_back(fen);
+		}
+	}
+	return fens;
+}
+
+//FNV-1a over the node counts, in order
+uint64_t addToSignature(uint64_t signature, uint64_t nodes) {
+	for (int i = 0; i < 8; i++) {
+		signature ^= (nodes >> (8 * i)) & 0xff;
+		signature *= 0x100000001b3ULL;
+	}
+	return signature;
+}
+
+int main(int argc, char* argv[]) {
+	int perftDepth = 4;
+	int searchDepth = 5;
+	int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+	bool bulk = true;
+	std::string fenDirectory = "../../FENs";
+	std::string networkPath;
+	std::string statsPath;
+	std::string bitbaseDirectory;
+	bool gameTree = false;
+
+	std::vector<int> numbers;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--no-bulk") bulk = false;
+		else if (arg == "--fens" && i + 1 < argc) fenDirectory = argv[++i];
+		else if (arg == "--nnue" && i + 1 < argc) networkPath = argv[++i];
+		else if (arg == "--stats" && i + 1 < argc) statsPath = argv[++i];
+		else if (arg == "--bitbases" && i + 1 < argc) bitbaseDirectory = argv[++i];
+		else if (arg == "--game-tree") gameTree = true;
+		else numbers.push_back(std::stoi(arg));
+	}
+	if (numbers.size() > 0) perftDepth = numbers[0];
+	if (numbers.size() > 1) searchDepth = numbers[1];
+	if (numbers.size() > 2) threads = numbers[2];
+
+	std::vector<std::string> positions = benchPositions;
+	std::vector<std::string> fenFiles = loadFenDirectory(fenDirectory);
+	positions.insert(positions.end(), fenFiles.begin(), fenFiles.end());
+
+	std::cout << positions.size() << " positions (" << fenFiles.size() << " from " << fenDirectory << ")" << std::endl;
+	uint64_t signature = 0xcbf29ce484222325ULL;
+
+	//perft
+	uint64_t perftNodes = 0;
+	double perftTime = 0;
+	for (const std::string& fen : positions) {
+		chess::Board board = chess::Board(fen);
+		auto start = std::chrono::high_resolution_clock::now();
+		uint64_t nodes = parallelPerft(board, perftDepth, bulk, threads);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::chrono::duration<double> duration = end - start;
+
+		perftNodes += nodes;
+		perftTime += duration.count();
+		signature = addToSignature(signature, nodes);
+		std::cout << "perft " << perftDepth << " " << std::setw(12) << nodes << "  " << fen << std::endl;
+	}
+
+	std::unique_ptr<SearchStatsLogger> statsLogger;
+	if (!statsPath.empty()) {
+		bool json = statsPath.size() >= 5 && statsPath.compare(statsPath.size() - 5, 5, ".json") == 0;
+		statsLogger = std::make_unique<SearchStatsLogger>(statsPath, json ? STATS_JSON : STATS_CSV);
+		if (!statsLogger->isOpen()) {
+			std::cerr << "could not open " << statsPath << std::endl;
+			return 1;
+		}
+	}
+
+	Bitbase bitbase;
+	if (!bitbaseDirectory.empty() && !bitbase.open(bitbaseDirectory)) {
+		std::cerr << "no bitbases in " << bitbaseDirectory << std::endl;
+		return 1;
+	}
+
+	//fixed-depth search
+	uint64_t searchNodes = 0;
+	double searchTime = 0;
+	for (const std::string& fen : positions) {
+		chess::Board board = chess::Board(fen);
+		ChessEngine engine(&board, searchDepth, BENCH_BEAM_WIDTH, 1);
+		engine.setSeed(BENCH_SEED);
+		if (!networkPath.empty()) {
+			if (!engine.loadNetwork(networkPath)) {
+				std::cerr << "could not load network " << networkPath << std::endl;
+				return 1;
+			}
+			engine.setEvalType(NNUE_EVAL);
+		}
+		engine.setStatsLogger(statsLogger.get());
+		engine.setBitbase(&bitbase);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		chess::Move move = engine.getBestMove();
+		auto end = std::chrono::high_resolution_clock::now();
+		std::chrono::duration<double> duration = end - start;
+
+		searchNodes += engine.getNodes();
+		searchTime += duration.count();
+		signature = addToSignature(signature, engine.getNodes());
+		std::cout << "search " << searchDepth << " " << std::setw(11) << engine.getNodes() << "  "
+			<< std::setw(6) << chess::uci::moveToUci(move) << "  " << fen << std::endl;
+	}
+
+	//persistent tree: every move is played through GameTree::makeMove, then the position after it is searched
+	//on the subtree that was kept and on a fresh tree, so the difference is what the reuse saves
+	uint64_t warmNodes = 0;
+	uint64_t coldNodes = 0;
+	uint64_t reusedNodes = 0;
+	for (size_t i = 0; gameTree && i < positions.size(); i++) {
+		chess::Board board = chess::Board(positions[i]);
+		ChessEngine evaluator(&board, searchDepth, BENCH_BEAM_WIDTH, 1);
+		evaluator.setSeed(BENCH_SEED);
+		GameTree tree(&evaluator, board);
+		chess::Move move = tree.alphaBetaSearch(searchDepth, BENCH_BEAM_WIDTH);
+
+		uint64_t warm = 0;
+		uint64_t cold = 0;
+		uint64_t reused = 0;
+		for (int ply = 0; ply < GAME_TREE_PLIES && move != chess::Move(chess::Move::NO_MOVE); ply++) {
+			tree.makeMove(move);
+			reused += tree.getReusedNodes();
+			GameTree fresh(&evaluator, tree.getBoard());
+			fresh.alphaBetaSearch(searchDepth, BENCH_BEAM_WIDTH);
+			cold += fresh.getNodesVisited();
+			move = tree.alphaBetaSearch(searchDepth, BENCH_BEAM_WIDTH);
+			warm += tree.getNodesVisited();
+		}
+		warmNodes += warm;
+		coldNodes += cold;
+		reusedNodes += reused;
+		std::cout << "tree " << searchDepth << " " << std::setw(13) << warm << " warm " << std::setw(11) << cold << " cold "
+			<< std::setw(10) << reused << " reused  " << positions[i] << std::endl;
+	}
+
+	std::cout << std::endl << std::fixed;
+	std::cout << "perft nodes      : " << perftNodes << std::endl;
+	std::cout << "perft nodes/s    : " << std::setprecision(0) << (perftTime > 0 ? perftNodes / perftTime : 0)
+		<< " (" << threads << " threads" << (bulk ? ", bulk counting" : "") << ")" << std::endl;
+	std::cout << "search nodes     : " << searchNodes << std::endl;
+	std::cout << "search nodes/s   : " << std::setprecision(0) << (searchTime > 0 ? searchNodes / searchTime : 0) << std::endl;
+	if (gameTree) {
+		std::cout << "tree nodes warm  : " << warmNodes << " (" << reusedNodes << " kept over " << GAME_TREE_PLIES << " moves a position)" << std::endl;
+		std::cout << "tree nodes cold  : " << coldNodes << std::endl;
+	}
+	std::cout << "total time (s)   : " << std::setprecision(3) << perftTime + searchTime << std::endl;
+	std::cout << "signature        : " << std::hex << signature << std::dec << std::endl;
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "chess.hpp"
+#include "Bitbase.h"
+
+//Generates the KQK, KRK and KPK bitbases into a directory, then maps them again and checks a few positions
+//whose results are known. The engine maps the directory at startup (uci option BitbasePath, bench
+//--bitbases, manager reads ../../bitbases).
+//
+//usage: bitbase_gen [directory] [threads]
+
+struct KnownResult {
+	std::string fen;
+	int result; //+1 white wins, 0 draw, -1 black wins
+};
+
+const std::vector<KnownResult> knownResults = {
+	{ "4k3/8/8/8/8/8/8/3QK3 w - - 0 1", 1 },
+	{ "3qk3/8/8/8/8/8/8/4K3 b - - 0 1", -1 },
+	{ "8/8/8/8/8/2k5/1R6/7K b - - 0 1", 0 },   //the rook hangs
+	{ "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", 0 },   //stalemate
+	{ "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", 1 },  //king in front of the pawn on the sixth
+	{ "8/8/8/8/8/4k3/4P3/4K3 w - - 0 1", 0 },  //the defending king has the square in front of the pawn
+	{ "8/8/8/8/8/k7/p7/K7 w - - 0 1", 0 },     //rook pawn, the defender reaches the corner
+};
+
+int main(int argc, char* argv[]) {
+	std::string directory = argc > 1 ? argv[1] : "../../bitbases";
+	int threads = argc > 2 ? std::stoi(argv[2]) : int(std::max(1u, std::thread::hardware_concurrency()));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!Bitbase::generate(directory, threads)) {
+		std::cerr << "could not write to " << directory << std::endl;
+		return 1;
+	}
+	std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "generated " << BITBASE_COUNT << " tables (" << BITBASE_COUNT * BITBASE_BYTES / 1024 << " KB) in "
+		<< std::fixed << std::setprecision(2) << duration.count() << " s on " << threads << " threads" << std::endl;
+
+	Bitbase bitbase;
+	bitbase.open(directory);
+	int mismatches = 0;
+	for (const KnownResult& known : knownResults) {
+		int result = 2;
+		bool found = bitbase.probe(chess::Board(known.fen), result);
+		bool ok = found && result == known.result;
+		mismatches += !ok;
+		std::cout << (ok ? "ok        " : "MISMATCH  ") << std::setw(2) << (found ? result : 2) << "  " << known.fen << std::endl;
+	}
+	return mismatches > 0 ? 1 : 0;
+}
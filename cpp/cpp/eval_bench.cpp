@@ -0,0 +1,83 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "chess.hpp"
+#include "ChessEngine.h"
+#include "BatchEval.h"
+
+//Throughput of evaluateBatch against ChessEngine::evaluate one position at a time, and a check that every batch
+//score matches the engine's own classical evaluation with the noise off, so the bench fails as soon as the two
+//drift apart. evaluateBatch has no game-end checks, so finished games are left out of the check. Positions come
+//from seeded random games, packed the way a dataset would store them; both timings include unpacking, and the
+//engine's also its legal move generation for the game-end check.
+//
+//usage: eval_bench [positions] [repeats]
+
+const int BENCH_SEED = 20240715;
+const int MAX_GAME_PLIES = 160;
+
+//every position of random games from the start, until a game ends or runs long
+std::vector<chess::PackedBoard> randomPositions(int count) {
+	std::mt19937 gen(BENCH_SEED);
+	std::vector<chess::PackedBoard> positions;
+	while (int(positions.size()) < count) {
+		chess::Board board;
+		for (int ply = 0; ply < MAX_GAME_PLIES && int(positions.size()) < count; ply++) {
+			chess::Movelist moves;
+			chess::movegen::legalmoves(moves, board);
+			if (moves.empty()) break;
+			board.makeMove(moves[gen() % moves.size()]);
+			positions.push_back(chess::Board::Compact::encode(board));
+		}
+	}
+	return positions;
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? std::stoi(argv[1]) : 1 << 16;
+	int repeats = argc > 2 ? std::stoi(argv[2]) : 10;
+	std::vector<chess::PackedBoard> positions = randomPositions(count);
+	std::vector<int16_t> single(count), batched(count);
+	chess::Board root;
+	ChessEngine engine(&root, 1, 1);
+	engine.setEvalNoise(NOISE_OFF);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++) {
+			chess::Board board = chess::Board::Compact::decode(positions[i]);
+			single[i] = engine.evaluate(&board);
+		}
+	}
+	std::chrono::duration<double, std::nano> singleTime = std::chrono::high_resolution_clock::now() - start;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		evaluateBatch(positions.data(), positions.size(), batched.data());
+	}
+	std::chrono::duration<double, std::nano> batchTime = std::chrono::high_resolution_clock::now() - start;
+
+	int mismatches = 0, finished = 0;
+	for (int i = 0; i < count; i++) {
+		chess::Board board = chess::Board::Compact::decode(positions[i]);
+		chess::Movelist moves;
+		chess::movegen::legalmoves(moves, board);
+		if (moves.empty() || board.isInsufficientMaterial() || board.isHalfMoveDraw()) {
+			finished++;
+			continue;
+		}
+		mismatches += single[i] != batched[i];
+	}
+
+	double evaluations = double(count) * repeats;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "positions        : " << count << " x " << repeats << std::endl;
+	std::cout << "engine ns/eval   : " << singleTime.count() / evaluations << std::endl;
+	std::cout << "batch ns/eval    : " << batchTime.count() / evaluations << "  (" << EVAL_BATCH_SIZE << " per batch)" << std::endl;
+	std::cout << "speedup          : " << std::setprecision(2) << singleTime.count() / batchTime.count() << "x" << std::endl;
+	std::cout << "score mismatches : " << mismatches << "  (" << finished << " finished games not compared)" << std::endl;
+	return mismatches > 0 ? 1 : 0;
+}
@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 #include <chrono>
+#include <future>
 
 #define BOARD_SIZE 800
 #define SQUARE_SIZE (BOARD_SIZE / 8)
@@ -169,7 +170,11 @@ void getBoardGraphicalRepresentation(char repr[8][8], square squares[8][8], bool
 
 int main() {
 	chess::Board board = chess::Board(); 
+	//made by bitbase_gen; declared first so it outlives the engine's ponder thread
+	Bitbase bitbase;
+	bitbase.open("../../bitbases");
 	ChessEngine engine(&board, 6, 12);
+	engine.setBitbase(&bitbase);
 	sf::RenderWindow window(sf::VideoMode({ BOARD_SIZE, BOARD_SIZE }), "Chess");
 	window.setFramerateLimit(30);
 	bool playingWhite = true;
@@ -200,6 +205,11 @@ int main() {
 
 	square *selectedSquare = nullptr;
 
+	//the engine thinks on its own thread so the window keeps drawing, and ponders while the player thinks
+	std::future<chess::Move> engineMove;
+	std::chrono::high_resolution_clock::time_point engineStart;
+	chess::Move lastPlayerMove = chess::Move(chess::Move::NO_MOVE);
+
 	ManagerState managerState = playingWhite == (board.sideToMove() == chess::Color::WHITE) ? WAITING_FOR_PLAYER_MOVE : WAITING_FOR_ENGINE_MOVE;
 
 	while (window.isOpen())
@@ -236,6 +246,7 @@ int main() {
 
 						if (engine.isLegalMove(move)) {
 							engine.makeMove(move);
+							lastPlayerMove = move;
 							fen = board.getFen();
 							getRepr(fen, repr, playingWhite);
 							managerState = WAITING_FOR_ENGINE_MOVE;
@@ -270,20 +281,29 @@ int main() {
 		}
 
 		window.display();
-		if (managerState == WAITING_FOR_ENGINE_MOVE) {
-			//TODO: make this on a separate thread.
-			auto start = std::chrono::high_resolution_clock::now();
-			chess::Move move = engine.getBestMove();
+		if (managerState == WAITING_FOR_ENGINE_MOVE && !engineMove.valid()) {
+			//a ponder hit picks up the search that has been running since the engine's last move
+			if (engine.isPondering()) {
+				std::cout << (engine.getPonderMove() == lastPlayerMove ? "Ponder hit" : "Ponder miss") << std::endl;
+			}
+			engineStart = std::chrono::high_resolution_clock::now();
+			engineMove = std::async(std::launch::async, [&engine]() { return engine.getBestMove(); });
+		}
+		else if (managerState == WAITING_FOR_ENGINE_MOVE && engineMove.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			chess::Move move = engineMove.get();
 			std::cout << chess::uci::moveToSan(board, move) << std::endl;
 			engine.makeMove(move);
 			auto end = std::chrono::high_resolution_clock::now();
-			std::chrono::duration<double> duration = end - start; // Duration in milliseconds
-			std::cout << "Execution time: " << duration.count() << " s" << std::endl;
+			std::chrono::duration<double> duration = end - engineStart; // Duration in milliseconds
+			std::cout << "Execution time: " << duration.count() << " s (depth " << engine.getCompletedDepth() << ")" << std::endl;
 			fen = board.getFen();
 			getRepr(fen, repr, playingWhite);
 			std::cout << "\n\n";
 			consolePrintRepr(repr);
 			std::cout << "\n\n";
+			if (engine.startPondering()) {
+				std::cout << "Pondering on " << chess::uci::moveToSan(board, engine.getPonderMove()) << std::endl;
+			}
 			managerState = ENGINE_PLAYED_MOVE;
 			selectedSquare = nullptr;
 		}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "chess.hpp"
+#include "PawnHashTable.h"
+
+//Microbenchmark for the pawn-structure kernel. Times PawnHashTable::evaluate against the diagonal-by-diagonal
+//loop countPawnStructure used before it, over the same random pawn structures, and checks every chain score
+//against a plain square-by-square count. The old loop compared each diagonal against the other diagonal's
+//stride, so it saw every chain as one pawn long; it is timed as it was, not checked.
+//
+//usage: pawn_bench [structures] [repeats]
+
+const int BENCH_SEED = 20240601;
+
+int16_t legacyPawnStructure(chess::Bitboard whitePawns, chess::Bitboard blackPawns) {
+	constexpr std::array<chess::Bitboard, 15> diagonalMasks = {
+		0x0000000000000001, 0x0000000000000102, 0x0000000000010204, 0x0000000001020408, 0x0000000102040810,
+		0x0000010204081020, 0x0001020408102040, 0x0102040810204080, 0x0204081020408000, 0x0408102040800000,
+		0x0810204080000000, 0x1020408000000000, 0x2040800000000000, 0x4080000000000000, 0x8000000000000000,
+	};
+	constexpr std::array<chess::Bitboard, 15> antiDiagonalMasks = {
+		0x0000000000000080, 0x0000000000008040, 0x0000000000804020, 0x0000000080402010, 0x0000008040201008,
+		0x0000804020100804, 0x0080402010080402, 0x8040201008040201, 0x4020100804020100, 0x2010080402010000,
+		0x1008040201000000, 0x0804020100000000, 0x0402010000000000, 0x0201000000000000, 0x0100000000000000,
+	};
+
+	int16_t longestWhitePawnChainLength = 0;
+	int16_t longestBlackPawnChainLength = 0;
+	for (auto [masks, stride] : { std::pair(diagonalMasks, 9), std::pair(antiDiagonalMasks, 7) }) {
+		for (auto [pawnBitboard, longest] : { std::pair(whitePawns, &longestWhitePawnChainLength), std::pair(blackPawns, &longestBlackPawnChainLength) }) {
+			for (chess::Bitboard diagonalMask : masks) {
+				chess::Bitboard pawnsOnDiagonal = pawnBitboard & diagonalMask;
+				int8_t prevSquare = -1;
+				int16_t currentChain = 0, bestChain = 0;
+				while (pawnsOnDiagonal) {
+					int8_t sq = pawnsOnDiagonal.pop();
+					if (prevSquare != -1 && sq == prevSquare + stride) currentChain++;
+					else currentChain = 1;
+					prevSquare = sq;
+					bestChain = std::max(bestChain, currentChain);
+				}
+				*longest = std::max(*longest, bestChain);
+			}
+		}
+	}
+	return (2 << longestWhitePawnChainLength) - (2 << longestBlackPawnChainLength);
+}
+
+//walks up both diagonals from every pawn, as slowly and obviously as possible
+int referenceChain(uint64_t pawns) {
+	int longest = 0;
+	for (int square = 0; square < 64; square++) {
+		if (!((pawns >> square) & 1)) continue;
+		for (int fileStep : { 1, -1 }) {
+			int length = 1;
+			int file = square & 7, rank = square >> 3;
+			while (file + fileStep >= 0 && file + fileStep < 8 && rank + 1 < 8 && ((pawns >> ((rank + 1) * 8 + file + fileStep)) & 1)) {
+				file += fileStep;
+				rank++;
+				length++;
+			}
+			longest = std::max(longest, length);
+		}
+	}
+	return longest;
+}
+
+//up to eight pawns a side, on the second to seventh ranks, never on the same square
+std::vector<std::pair<uint64_t, uint64_t>> randomStructures(int count) {
+	std::mt19937_64 gen(BENCH_SEED);
+	std::vector<std::pair<uint64_t, uint64_t>> structures;
+	for (int i = 0; i < count; i++) {
+		uint64_t sides[2] = { 0, 0 };
+		for (uint64_t& side : sides) {
+			int pawns = int(gen() % 9);
+			for (int p = 0; p < pawns; p++) {
+				int square = 8 + int(gen() % 48);
+				if (!(((sides[0] | sides[1]) >> square) & 1)) side |= 1ULL << square;
+			}
+		}
+		structures.push_back({ sides[0], sides[1] });
+	}
+	return structures;
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? std::stoi(argv[1]) : 1 << 16;
+	int repeats = argc > 2 ? std::stoi(argv[2]) : 20;
+	std::vector<std::pair<uint64_t, uint64_t>> structures = randomStructures(count);
+
+	int mismatches = 0;
+	for (const auto& [white, black] : structures) {
+		PawnEntry entry;
+		PawnHashTable::evaluate(white, black, entry);
+		if (entry.score != (2 << referenceChain(white)) - (2 << referenceChain(black))) mismatches++;
+	}
+
+	//the sums keep the compiler from dropping the work
+	int64_t legacySum = 0, kernelSum = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (const auto& [white, black] : structures) {
+			legacySum += legacyPawnStructure(chess::Bitboard(white), chess::Bitboard(black));
+		}
+	}
+	std::chrono::duration<double, std::nano> legacyTime = std::chrono::high_resolution_clock::now() - start;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (const auto& [white, black] : structures) {
+			PawnEntry entry;
+			PawnHashTable::evaluate(white, black, entry);
+			kernelSum += entry.score + entry.islands[0] + entry.passed[1].count();
+		}
+	}
+	std::chrono::duration<double, std::nano> kernelTime = std::chrono::high_resolution_clock::now() - start;
+
+	double evaluations = double(count) * repeats;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "structures       : " << count << " x " << repeats << std::endl;
+	std::cout << "legacy ns/eval   : " << legacyTime.count() / evaluations << "  (chains only, sum " << legacySum << ")" << std::endl;
+	std::cout << "kernel ns/eval   : " << kernelTime.count() / evaluations << "  (chains, islands, passed, isolated, doubled, spans, sum " << kernelSum << ")" << std::endl;
+	std::cout << "speedup          : " << std::setprecision(2) << legacyTime.count() / kernelTime.count() << "x" << std::endl;
+	std::cout << "chain mismatches : " << mismatches << std::endl;
+	return mismatches > 0 ? 1 : 0;
+}
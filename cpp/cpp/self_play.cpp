@@ -0,0 +1,442 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include "chess.hpp"
+#include "ChessEngine.h"
+
+//Self-play match between two engine configurations, to tell whether a change made the engine stronger or only
+//slower. Games run concurrently, one per worker, each worker with its own pair of engines. Every opening is
+//played twice with colours swapped, so a lopsided opening favours neither side. After every game the running
+//score, Elo difference with its 95% margin and, with --sprt, the log-likelihood ratio are printed; the SPRT
+//stops the match as soon as it can accept or reject. Finished games are appended to a PGN file, one full move
+//per line like python/game_logger.py.
+//
+//A configuration is a comma-separated list of key=value, e.g. "name=lmr,depth=8,beam=12,eval=nnue:net.bin":
+//    name      shown in the output and the PGN, defaults to the whole spec
+//    depth     plies per move                    tc        game clock, <ms>+<increment ms>, e.g. tc=10000+100
+//    movetime  ms per move                       nodes     nodes per move
+//    beam      beamWidth (default 12)            hash      MB per engine (default 16)
+//    eval      classical, or nnue:<weights>      noise     hashed (default) or off
+//With no limit given a configuration searches to depth 6. A clock is the only limit that charges a
+//configuration for being slow, so speed against strength is best measured with tc.
+//
+//usage: self_play [--games <n>] [--concurrency <n>] [--openings <file>] [--pgn <file>] [--max-plies <n>] [--seed <n>] [--sprt <elo0> <elo1> [--alpha <a>] [--beta <b>]] <configA> <configB>
+//    --openings reads FEN/EPD lines, or lines of UCI moves from the start position; there is a built-in set
+//    --sprt tests elo0 (e.g. 0) against elo1 (e.g. 5) for configA, at alpha and beta (default 0.05 each)
+
+const int DEFAULT_BEAM_WIDTH = 12;
+const int DEFAULT_DEPTH = 6;
+const int DEFAULT_MAX_PLIES = 400; //a longer game is adjudicated a draw
+const int MOVE_OVERHEAD_MS = 10;   //no GUI or pipe in between, only the search noticing its deadline
+const int DEFAULT_MOVES_TO_GO = 30;
+
+//common, roughly balanced openings, as UCI moves from the start position
+const std::vector<std::string> builtInOpenings = {
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6",
+	"e2e4 e7e6 d2d4 d7d5",
+	"e2e4 c7c6 d2d4 d7d5",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+	"d2d4 d7d5 c2c4 c7c6",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6",
+	"c2c4 e7e5 b1c3 g8f6",
+	"g1f3 d7d5 g2g3 g8f6 f1g2",
+};
+
+const std::string startFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct EngineConfig {
+	std::string name;
+	int depth = 0;
+	int64_t moveTimeMs = 0;
+	uint64_t nodes = 0;
+	int64_t timeMs = 0; //game clock, 0 for none
+	int64_t incrementMs = 0;
+	int beamWidth = DEFAULT_BEAM_WIDTH;
+	int hashSizeMB = 16;
+	std::string network; //empty for the classical evaluation
+	EvalNoise evalNoise = NOISE_HASHED;
+};
+
+struct Opening {
+	std::string fen;
+	std::vector<chess::Move> moves; //played from fen before the engines take over
+};
+
+struct GameRecord {
+	int index;
+	int white; //0 for configA, 1 for configB
+	Opening opening;
+	std::vector<chess::Move> moves; //the engines' moves, after the opening
+	GameState result;
+	std::string termination;
+};
+
+//false on anything it doesn't understand, so a typo can't quietly run the wrong match
+bool parseConfig(const std::string& spec, EngineConfig& config) {
+	config.name = spec;
+	std::istringstream in(spec);
+	std::string pair;
+	while (std::getline(in, pair, ',')) {
+		size_t equals = pair.find('=');
+		if (equals == std::string::npos) return false;
+		std::string key = pair.substr(0, equals), value = pair.substr(equals + 1);
+		if (key == "name") config.name = value;
+		else if (key == "depth") config.depth = std::stoi(value);
+		else if (key == "movetime") config.moveTimeMs = std::stoll(value);
+		else if (key == "nodes") config.nodes = std::stoull(value);
+		else if (key == "beam") config.beamWidth = std::max(1, std::stoi(value));
+		else if (key == "hash") config.hashSizeMB = std::max(1, std::stoi(value));
+		else if (key == "noise" && (value == "hashed" || value == "off")) config.evalNoise = value == "off" ? NOISE_OFF : NOISE_HASHED;
+		else if (key == "eval" && value == "classical") config.network.clear();
+		else if (key == "eval" && value.rfind("nnue:", 0) == 0) config.network = value.substr(5);
+		else if (key == "tc") {
+			size_t plus = value.find('+');
+			config.timeMs = std::stoll(value.substr(0, plus));
+			config.incrementMs = plus == std::string::npos ? 0 : std::stoll(value.substr(plus + 1));
+		}
+		else return false;
+	}
+	if (config.depth == 0 && config.moveTimeMs == 0 && config.nodes == 0 && config.timeMs == 0) config.depth = DEFAULT_DEPTH;
+	return true;
+}
+
+std::unique_ptr<ChessEngine> createEngine(const EngineConfig& config, chess::Board* board) {
+	std::unique_ptr<ChessEngine> engine = std::make_unique<ChessEngine>(board, config.depth > 0 ? config.depth : MAX_DEPTH, config.beamWidth, 1, config.hashSizeMB);
+	if (!config.network.empty() && (!engine->loadNetwork(config.network) || !engine->setEvalType(NNUE_EVAL))) return nullptr;
+	engine->setEvalNoise(config.evalNoise);
+	return engine;
+}
+
+//A line with a '/' is a FEN or EPD position; anything else is UCI moves from the start position
+bool parseOpening(const std::string& line, Opening& opening) {
+	std::istringstream fields(line);
+	std::vector<std::string> parts;
+	std::string part;
+	while (fields >> part) parts.push_back(part);
+	if (parts.empty() || parts[0][0] == '#') return false;
+
+	if (parts[0].find('/') != std::string::npos) {
+		if (parts.size() < 4) return false;
+		opening.fen = parts[0] + " " + parts[1] + " " + parts[2] + " " + parts[3];
+		bool hasCounters = parts.size() >= 6 && std::isdigit(parts[4][0]) && std::isdigit(parts[5][0]);
+		opening.fen += hasCounters ? " " + parts[4] + " " + parts[5] : " 0 1";
+		return true;
+	}
+	opening.fen = startFen;
+	chess::Board board = chess::Board(startFen);
+	for (const std::string& uci : parts) {
+		chess::Move move = chess::uci::uciToMove(board, uci);
+		chess::Movelist legalMoves;
+		chess::movegen::legalmoves(legalMoves, board);
+		if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end()) return false;
+		opening.moves.push_back(move);
+		board.makeMove(move);
+	}
+	return true;
+}
+
+//Plays one game on board with the two engines, engines[white] as white. Both engines were made with board,
+//so they see every move as it is played.
+void playGame(GameRecord& game, const EngineConfig* configs, std::unique_ptr<ChessEngine>* engines, chess::Board& board, int maxPlies, uint32_t seed) {
+	board = chess::Board(game.opening.fen);
+	for (chess::Move move : game.opening.moves) board.makeMove(move);
+	int64_t clockMs[2];
+	for (int side = 0; side < 2; side++) {
+		engines[side]->clearHash();
+		engines[side]->setSeed(seed + uint32_t(game.index) * 2 + side);
+		clockMs[side] = configs[side].timeMs;
+	}
+
+	for (int ply = 0; ; ply++) {
+		chess::Movelist legalMoves;
+		chess::movegen::legalmoves(legalMoves, board);
+		bool whiteToMove = board.sideToMove() == chess::Color::WHITE;
+		if (legalMoves.empty()) {
+			game.result = !board.inCheck() ? DRAW : whiteToMove ? BLACK_WINS : WHITE_WINS;
+			game.termination = board.inCheck() ? "checkmate" : "stalemate";
+			return;
+		}
+		if (board.isInsufficientMaterial() || board.isRepetition() || board.isHalfMoveDraw()) {
+			game.result = DRAW;
+			game.termination = board.isInsufficientMaterial() ? "insufficient material" : board.isRepetition() ? "threefold repetition" : "fifty-move rule";
+			return;
+		}
+		if (ply >= maxPlies) {
+			game.result = DRAW;
+			game.termination = "adjudication: move limit";
+			return;
+		}
+
+		int side = whiteToMove ? game.white : 1 - game.white;
+		const EngineConfig& config = configs[side];
+		SearchLimits limits;
+		limits.depth = config.depth;
+		limits.nodes = config.nodes;
+		auto start = std::chrono::steady_clock::now();
+		int64_t budgetMs = config.moveTimeMs;
+		if (config.timeMs > 0) {
+			//the same share of the clock uci gives itself
+			int64_t clockBudgetMs = clockMs[side] / DEFAULT_MOVES_TO_GO + config.incrementMs * 3 / 4;
+			clockBudgetMs = std::max<int64_t>(1, std::min(clockBudgetMs, clockMs[side] - MOVE_OVERHEAD_MS));
+			budgetMs = budgetMs > 0 ? std::min(budgetMs, clockBudgetMs) : clockBudgetMs;
+		}
+		if (budgetMs > 0) limits.deadline = start + std::chrono::milliseconds(budgetMs);
+
+		chess::Move move = engines[side]->getBestMove(limits);
+		int64_t spentMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end()) {
+			game.result = whiteToMove ? BLACK_WINS : WHITE_WINS;
+			game.termination = "illegal move";
+			return;
+		}
+		if (config.timeMs > 0) {
+			clockMs[side] -= spentMs;
+			if (clockMs[side] < 0) {
+				game.result = whiteToMove ? BLACK_WINS : WHITE_WINS;
+				game.termination = "time forfeit";
+				return;
+			}
+			clockMs[side] += config.incrementMs;
+		}
+		game.moves.push_back(move);
+		board.makeMove(move);
+	}
+}
+
+std::string resultString(GameState result) {
+	switch (result) {
+	case WHITE_WINS:
+		return "1-0";
+	case BLACK_WINS:
+		return "0-1";
+	case DRAW:
+		return "1/2-1/2";
+	default:
+		return "*";
+	}
+}
+
+//Standard tags, then the moves one full move per line the way python/game_logger.py writes them
+std::string formatPgn(const GameRecord& game, const EngineConfig* configs, const std::string& date) {
+	std::ostringstream pgn;
+	pgn << "[Event \"self-play " << configs[0].name << " vs " << configs[1].name << "\"]\n";
+	pgn << "[Site \"?\"]\n";
+	pgn << "[Date \"" << date << "\"]\n";
+	pgn << "[Round \"" << game.index + 1 << "\"]\n";
+	pgn << "[White \"" << configs[game.white].name << "\"]\n";
+	pgn << "[Black \"" << configs[1 - game.white].name << "\"]\n";
+	pgn << "[Result \"" << resultString(game.result) << "\"]\n";
+	pgn << "[Termination \"" << game.termination << "\"]\n";
+	if (game.opening.fen != startFen) {
+		pgn << "[SetUp \"1\"]\n";
+		pgn << "[FEN \"" << game.opening.fen << "\"]\n";
+	}
+	pgn << "\n";
+
+	chess::Board board = chess::Board(game.opening.fen);
+	std::vector<chess::Move> moves = game.opening.moves;
+	moves.insert(moves.end(), game.moves.begin(), game.moves.end());
+	bool lastWasWhite = false;
+	for (chess::Move move : moves) {
+		int moveNumber = board.fullMoveNumber();
+		std::string san = chess::uci::moveToSan(board, move);
+		if (board.sideToMove() == chess::Color::WHITE) {
+			pgn << moveNumber << ". " << san << " ";
+			lastWasWhite = true;
+		}
+		else {
+			if (lastWasWhite) pgn << san << "\n";
+			else pgn << moveNumber << "... " << san << "\n";
+			lastWasWhite = false;
+		}
+		board.makeMove(move);
+	}
+	pgn << resultString(game.result) << "\n\n";
+	return pgn.str();
+}
+
+double scoreFromElo(double elo) {
+	return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+double eloFromScore(double score) {
+	score = std::clamp(score, 1e-3, 1.0 - 1e-3); //a clean sweep says nothing finite
+	return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+//Wins, draws and losses of configA. Elo and the SPRT both use the trinomial model: the mean and the
+//variance of a game's score.
+struct MatchTally {
+	int wins = 0;
+	int draws = 0;
+	int losses = 0;
+
+	int games() const { return this->wins + this->draws + this->losses; }
+	double score() const { return (this->wins + 0.5 * this->draws) / this->games(); }
+	double variance() const {
+		double s = this->score();
+		return (this->wins * (1 - s) * (1 - s) + this->draws * (0.5 - s) * (0.5 - s) + this->losses * s * s) / this->games();
+	}
+	double elo() const { return eloFromScore(this->score()); }
+	double eloMargin() const {
+		double error = 1.96 * std::sqrt(this->variance() / this->games());
+		return (eloFromScore(this->score() + error) - eloFromScore(this->score() - error)) / 2;
+	}
+	//log-likelihood ratio of elo1 over elo0, in the normal approximation
+	double llr(double elo0, double elo1) const {
+		double variance = this->variance();
+		if (variance <= 0) return 0;
+		double s0 = scoreFromElo(elo0), s1 = scoreFromElo(elo1);
+		return (s1 - s0) * (2 * this->score() - s0 - s1) * this->games() / (2 * variance);
+	}
+};
+
+int main(int argc, char* argv[]) {
+	int games = 100;
+	int concurrency = int(std::max(1u, std::thread::hardware_concurrency()));
+	std::string openingsPath;
+	std::string pgnPath = "self_play.pgn";
+	int maxPlies = DEFAULT_MAX_PLIES;
+	uint32_t seed = uint32_t(std::chrono::system_clock::now().time_since_epoch().count());
+	bool sprt = false;
+	double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+	std::vector<std::string> specs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--games" && i + 1 < argc) games = std::stoi(argv[++i]);
+		else if (arg == "--concurrency" && i + 1 < argc) concurrency = std::max(1, std::stoi(argv[++i]));
+		else if (arg == "--openings" && i + 1 < argc) openingsPath = argv[++i];
+		else if (arg == "--pgn" && i + 1 < argc) pgnPath = argv[++i];
+		else if (arg == "--max-plies" && i + 1 < argc) maxPlies = std::stoi(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc) seed = uint32_t(std::stoul(argv[++i]));
+		else if (arg == "--alpha" && i + 1 < argc) alpha = std::stod(argv[++i]);
+		else if (arg == "--beta" && i + 1 < argc) beta = std::stod(argv[++i]);
+		else if (arg == "--sprt" && i + 2 < argc) {
+			sprt = true;
+			elo0 = std::stod(argv[++i]);
+			elo1 = std::stod(argv[++i]);
+		}
+		else specs.push_back(arg);
+	}
+	EngineConfig configs[2];
+	if (specs.size() != 2 || !parseConfig(specs[0], configs[0]) || !parseConfig(specs[1], configs[1])) {
+		std::cerr << "usage: self_play [options] <configA> <configB>, e.g. self_play depth=6 depth=6,beam=8" << std::endl;
+		return 1;
+	}
+	for (const EngineConfig& config : configs) {
+		chess::Board board;
+		if (!createEngine(config, &board)) {
+			std::cerr << "could not load network " << config.network << " for " << config.name << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Opening> openings;
+	std::vector<std::string> openingLines = builtInOpenings;
+	if (!openingsPath.empty()) {
+		std::ifstream in(openingsPath);
+		if (!in) {
+			std::cerr << "could not open " << openingsPath << std::endl;
+			return 1;
+		}
+		openingLines.clear();
+		std::string line;
+		while (std::getline(in, line)) openingLines.push_back(line);
+	}
+	for (const std::string& line : openingLines) {
+		Opening opening;
+		if (parseOpening(line, opening)) openings.push_back(opening);
+	}
+	if (openings.empty()) {
+		std::cerr << "no openings" << std::endl;
+		return 1;
+	}
+
+	std::ofstream pgn(pgnPath, std::ios::app);
+	if (!pgn) {
+		std::cerr << "could not open " << pgnPath << std::endl;
+		return 1;
+	}
+	std::time_t now = std::time(nullptr);
+	char date[16];
+	std::strftime(date, sizeof(date), "%Y.%m.%d", std::localtime(&now));
+
+	double lowerBound = std::log(beta / (1 - alpha)), upperBound = std::log((1 - beta) / alpha);
+	std::cout << configs[0].name << " vs " << configs[1].name << ": up to " << games << " games, " << concurrency
+		<< " at a time, " << openings.size() << " openings, seed " << seed << std::endl;
+	if (sprt) {
+		std::cout << "SPRT elo0 " << elo0 << " elo1 " << elo1 << ", alpha " << alpha << " beta " << beta
+			<< ", LLR bounds [" << std::setprecision(3) << lowerBound << ", " << upperBound << "]" << std::endl;
+	}
+
+	//games are handed out in order, so each opening's pair is played close together
+	std::atomic<int> nextGame(0);
+	std::atomic<bool> stop(false);
+	std::mutex resultMutex;
+	MatchTally tally;
+	std::string verdict;
+	std::vector<std::thread> workers;
+	for (int w = 0; w < std::min(concurrency, games); w++) {
+		workers.emplace_back([&]() {
+			chess::Board board;
+			std::unique_ptr<ChessEngine> engines[2] = { createEngine(configs[0], &board), createEngine(configs[1], &board) };
+			for (int index = nextGame++; index < games && !stop; index = nextGame++) {
+				GameRecord game;
+				game.index = index;
+				game.white = index % 2;
+				game.opening = openings[(index / 2) % openings.size()];
+				playGame(game, configs, engines, board, maxPlies, seed);
+
+				std::lock_guard<std::mutex> lock(resultMutex);
+				pgn << formatPgn(game, configs, date);
+				pgn.flush();
+				bool aWon = game.result == (game.white == 0 ? WHITE_WINS : BLACK_WINS);
+				if (game.result == DRAW) tally.draws++;
+				else if (aWon) tally.wins++;
+				else tally.losses++;
+
+				std::cout << std::fixed << std::setprecision(1) << "game " << std::setw(5) << index + 1 << "  "
+					<< std::setw(7) << resultString(game.result) << " " << std::left << std::setw(26) << game.termination << std::right
+					<< "  +" << tally.wins << " =" << tally.draws << " -" << tally.losses
+					<< "  Elo " << std::showpos << tally.elo() << std::noshowpos << " +- " << tally.eloMargin();
+				if (sprt) {
+					double llr = tally.llr(elo0, elo1);
+					std::cout << "  LLR " << std::setprecision(2) << llr;
+					if (verdict.empty() && (llr <= lowerBound || llr >= upperBound)) {
+						verdict = llr >= upperBound ? "H1 accepted: " + configs[0].name + " is stronger" : "H0 accepted: " + configs[0].name + " is not stronger";
+						stop = true;
+					}
+				}
+				std::cout << std::endl;
+			}
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	if (tally.games() > 0) {
+		std::cout << std::endl << configs[0].name << " vs " << configs[1].name << ": " << tally.games() << " games, +"
+			<< tally.wins << " =" << tally.draws << " -" << tally.losses << ", score " << std::setprecision(1) << tally.score() * 100
+			<< "%, Elo " << std::showpos << tally.elo() << std::noshowpos << " +- " << tally.eloMargin() << std::endl;
+	}
+	if (sprt) std::cout << (verdict.empty() ? "SPRT inconclusive, out of games" : verdict) << std::endl;
+	std::cout << "games written to " << pgnPath << std::endl;
+	return 0;
+}
@@ -0,0 +1,303 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+#include <charconv>
+#include "chess.hpp"
+#include "ChessEngine.h"
+#include "App.h" //uWebSockets, cpp/uWebSockets/src, linked against its uSockets
+
+//WebSocket engine server for the web frontend (frontend/src/ChessEngineConnection.tsx) and anything else that
+//wants moves over the network. Every connection is one game with its own board. The uWebSockets event loop
+//only parses messages and queues searches; a fixed pool of workers, each with its own ChessEngine, runs them
+//and hands the answer back to the loop to send. When every worker is busy and the queue is full, a go is
+//turned away with a busy message at once instead of piling up.
+//
+//Messages are flat JSON objects:
+//    -> {"type":"position","fen":"<fen or startpos>","moves":["e2e4",...]}
+//    -> {"type":"go","movetime":<ms>,"depth":<plies>}     both optional, movetime is capped by the server
+//    <- {"type":"move","move":"e7e5","score":<centipawns for white>,"depth":..,"nodes":..,"timeMs":..,"queuedMs":..}
+//    <- {"type":"busy","retryAfterMs":..}
+//    <- {"type":"error","message":".."}
+//
+//usage: server [port] [workers] [queueLength] [maxMoveTimeMs] [depth] [book.bin]
+
+const std::string startFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+const int SERVER_BEAM_WIDTH = 12;
+const int SERVER_HASH_SIZE_MB = 16;
+
+struct SocketData;
+typedef uWS::WebSocket<false, true, SocketData> Socket;
+
+struct Game {
+	int id;
+	chess::Board board = chess::Board(startFen);
+	Socket* socket = nullptr; //nullptr once the client has gone. Only touched on the loop thread
+	bool searching = false;
+};
+
+struct SocketData {
+	std::shared_ptr<Game> game;
+};
+
+struct SearchJob {
+	std::shared_ptr<Game> game;
+	chess::Board board;
+	SearchLimits limits;
+	std::chrono::steady_clock::time_point received;
+};
+
+//Just enough JSON for the flat messages above: no nesting, no escapes.
+size_t findValue(std::string_view message, const std::string& key) {
+	size_t at = message.find("\"" + key + "\"");
+	if (at == std::string_view::npos) return at;
+	at = message.find(':', at + key.size() + 2);
+	if (at == std::string_view::npos) return at;
+	return message.find_first_not_of(" \t\r\n", at + 1);
+}
+
+std::string jsonString(std::string_view message, const std::string& key) {
+	size_t at = findValue(message, key);
+	if (at == std::string_view::npos || message[at] != '"') return "";
+	size_t end = message.find('"', at + 1);
+	if (end == std::string_view::npos) return "";
+	return std::string(message.substr(at + 1, end - at - 1));
+}
+
+//anything that isn't a whole number that fits, "--5" or twenty digits, is the fallback: no client message may throw
+int64_t jsonNumber(std::string_view message, const std::string& key, int64_t fallback) {
+	size_t at = findValue(message, key);
+	if (at == std::string_view::npos) return fallback;
+	int64_t value;
+	std::from_chars_result parsed = std::from_chars(message.data() + at, message.data() + message.size(), value);
+	if (parsed.ec != std::errc()) return fallback;
+	return value;
+}
+
+std::vector<std::string> jsonStringArray(std::string_view message, const std::string& key) {
+	std::vector<std::string> values;
+	size_t at = findValue(message, key);
+	if (at == std::string_view::npos || message[at] != '[') return values;
+	size_t end = message.find(']', at);
+	for (size_t quote = message.find('"', at); quote < end; quote = message.find('"', quote + 1)) {
+		size_t close = message.find('"', quote + 1);
+		if (close >= end) break;
+		values.emplace_back(message.substr(quote + 1, close - quote - 1));
+		quote = close;
+	}
+	return values;
+}
+
+//A fixed set of search workers behind a bounded queue. Each worker keeps its engine, and so its hash table,
+//for the life of the server; games share them, which is fine since entries are keyed by position.
+class EnginePool {
+	public:
+		EnginePool(uWS::Loop* loop, int workers, size_t queueLength, int depth, const OpeningBook* book);
+		~EnginePool();
+		bool trySubmit(SearchJob job); //false when the queue is full
+		size_t getQueued();
+	private:
+		void work();
+		void finish(const SearchJob& job, std::chrono::steady_clock::time_point started, chess::Move move, int depth, uint64_t nodes);
+
+		uWS::Loop* loop;
+		size_t queueLength;
+		int depth;
+		const OpeningBook* book; //shared by every worker's engine, nullptr for none
+		std::deque<SearchJob> queue;
+		std::mutex queueMutex;
+		std::condition_variable queueReady;
+		bool shuttingDown;
+		std::vector<std::thread> workers;
+};
+
+EnginePool::EnginePool(uWS::Loop* loop, int workers, size_t queueLength, int depth, const OpeningBook* book) {
+	this->loop = loop;
+	this->queueLength = queueLength;
+	this->depth = depth;
+	this->book = book;
+	this->shuttingDown = false;
+	for (int i = 0; i < workers; i++) {
+		this->workers.emplace_back([this]() { this->work(); });
+	}
+}
+
+EnginePool::~EnginePool() {
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+		this->shuttingDown = true;
+	}
+	this->queueReady.notify_all();
+	for (std::thread& worker : this->workers) {
+		worker.join();
+	}
+}
+
+bool EnginePool::trySubmit(SearchJob job) {
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+		if (this->queue.size() >= this->queueLength) return false;
+		this->queue.push_back(std::move(job));
+	}
+	this->queueReady.notify_one();
+	return true;
+}
+
+size_t EnginePool::getQueued() {
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	return this->queue.size();
+}
+
+void EnginePool::work() {
+	chess::Board board = chess::Board(startFen);
+	ChessEngine engine(&board, this->depth, SERVER_BEAM_WIDTH, 1, SERVER_HASH_SIZE_MB);
+	engine.setOpeningBook(this->book);
+
+	while (true) {
+		SearchJob job;
+		{
+			std::unique_lock<std::mutex> lock(this->queueMutex);
+			this->queueReady.wait(lock, [this]() { return this->shuttingDown || !this->queue.empty(); });
+			if (this->shuttingDown) return;
+			job = std::move(this->queue.front());
+			this->queue.pop_front();
+		}
+
+		//the engine searches the board it was made with, so the game's position is copied in, history and all
+		auto started = std::chrono::steady_clock::now();
+		board = job.board;
+		chess::Move move = engine.getBestMove(job.limits);
+		this->finish(job, started, move, engine.getCompletedDepth(), engine.getNodes());
+	}
+}
+
+void EnginePool::finish(const SearchJob& job, std::chrono::steady_clock::time_point started, chess::Move move, int depth, uint64_t nodes) {
+	auto now = std::chrono::steady_clock::now();
+	std::string reply = "{\"type\":\"move\",\"move\":\"" + chess::uci::moveToUci(move)
+		+ "\",\"score\":" + std::to_string(move.score() * 100 / 256)
+		+ ",\"depth\":" + std::to_string(depth)
+		+ ",\"nodes\":" + std::to_string(nodes)
+		+ ",\"timeMs\":" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - job.received).count())
+		+ ",\"queuedMs\":" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(started - job.received).count())
+		+ "}";
+
+	//sockets may only be used from the loop's own thread
+	std::shared_ptr<Game> game = job.game;
+	this->loop->defer([game, reply]() {
+		game->searching = false;
+		if (game->socket != nullptr) game->socket->send(reply, uWS::OpCode::TEXT);
+	});
+}
+
+void sendError(Socket* socket, const std::string& message) {
+	socket->send("{\"type\":\"error\",\"message\":\"" + message + "\"}", uWS::OpCode::TEXT);
+}
+
+void setPosition(Game* game, std::string_view message) {
+	std::string fen = jsonString(message, "fen");
+	if (fen.empty() || fen == "startpos") fen = startFen;
+	//the client's text never reaches chess::Board unchecked, and the search needs both kings
+	if (!ChessEngine::isValidFen(fen)) {
+		sendError(game->socket, "not a position");
+		return;
+	}
+	//built aside, so a bad move leaves the game on the last position the client did set
+	chess::Board board = chess::Board(fen);
+	if (board.pieces(chess::PieceType::KING, chess::Color::WHITE).count() != 1 || board.pieces(chess::PieceType::KING, chess::Color::BLACK).count() != 1) {
+		sendError(game->socket, "needs one king a side");
+		return;
+	}
+
+	chess::Movelist legalMoves;
+	for (const std::string& uci : jsonStringArray(message, "moves")) {
+		chess::Move move = chess::uci::uciToMove(board, uci);
+		chess::movegen::legalmoves(legalMoves, board);
+		if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end()) {
+			sendError(game->socket, "illegal move " + uci);
+			return;
+		}
+		board.makeMove(move);
+	}
+	game->board = board;
+}
+
+int main(int argc, char* argv[]) {
+	int port = argc > 1 ? std::stoi(argv[1]) : 8080;
+	int workers = argc > 2 ? std::stoi(argv[2]) : int(std::max(1u, std::thread::hardware_concurrency()));
+	size_t queueLength = argc > 3 ? std::stoul(argv[3]) : size_t(workers) * 4;
+	int64_t maxMoveTimeMs = argc > 4 ? std::stoll(argv[4]) : 5000;
+	int depth = argc > 5 ? std::stoi(argv[5]) : 6;
+	//mapped once for all workers, and shared with any other server on the machine through the page cache
+	OpeningBook book;
+	if (argc > 6 && !book.open(argv[6])) {
+		std::cerr << "could not open book " << argv[6] << std::endl;
+		return 1;
+	}
+
+	uWS::App app;
+	EnginePool pool(uWS::Loop::get(), workers, queueLength, depth, book.isOpen() ? &book : nullptr);
+	int nextGameId = 0;
+
+	app.ws<SocketData>("/*", {
+		.compression = uWS::DISABLED,
+		.maxPayloadLength = 16 * 1024,
+		.idleTimeout = 120,
+		.maxBackpressure = 64 * 1024,
+		.open = [&nextGameId](Socket* socket) {
+			std::shared_ptr<Game> game = std::make_shared<Game>();
+			game->id = nextGameId++;
+			game->socket = socket;
+			socket->getUserData()->game = game;
+		},
+		.message = [&pool, maxMoveTimeMs, workers](Socket* socket, std::string_view message, uWS::OpCode) {
+			std::shared_ptr<Game> game = socket->getUserData()->game;
+			std::string type = jsonString(message, "type");
+
+			if (type == "position") {
+				if (game->searching) sendError(socket, "position sent while a search is running");
+				else setPosition(game.get(), message);
+			}
+			else if (type == "go") {
+				if (game->searching) {
+					sendError(socket, "already searching");
+					return;
+				}
+				//the budget starts now, time spent waiting in the queue counts against it
+				SearchJob job;
+				job.game = game;
+				job.board = game->board;
+				job.received = std::chrono::steady_clock::now();
+				int64_t moveTimeMs = std::clamp<int64_t>(jsonNumber(message, "movetime", maxMoveTimeMs), 1, maxMoveTimeMs);
+				job.limits.deadline = job.received + std::chrono::milliseconds(moveTimeMs);
+				job.limits.depth = int(jsonNumber(message, "depth", 0));
+
+				if (!pool.trySubmit(std::move(job))) {
+					//roughly how long until a worker frees up, so clients don't retry in a tight loop
+					int64_t retryAfterMs = std::max<int64_t>(1, moveTimeMs * int64_t(pool.getQueued()) / workers);
+					socket->send("{\"type\":\"busy\",\"retryAfterMs\":" + std::to_string(retryAfterMs) + "}", uWS::OpCode::TEXT);
+					return;
+				}
+				game->searching = true;
+			}
+			else {
+				sendError(socket, "unknown message type");
+			}
+		},
+		.close = [](Socket* socket, int, std::string_view) {
+			//a search may still be running for this game, it just has nowhere to send the answer any more
+			socket->getUserData()->game->socket = nullptr;
+		}
+	}).listen(port, [port, workers](auto* listenSocket) {
+		if (listenSocket) std::cout << "listening on port " << port << " with " << workers << " search workers" << std::endl;
+		else std::cerr << "could not listen on port " << port << std::endl;
+	}).run();
+
+	return 0;
+}
@@ -0,0 +1,281 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "chess.hpp"
+
+//Load test for server.cpp. Plays N games at once, one connection each: the server picks the moves of one
+//side, a random mover the other, and every go is timed from send to answer. Prints the p50/p90/p99 move
+//latency, the moves per second the server sustained and how often it pushed back with busy.
+//POSIX sockets or Winsock and a minimal WebSocket client, so no more dependencies than the engine itself.
+//
+//usage: server_load_test [games] [movesPerGame] [movetimeMs] [host] [port]
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+const Socket NO_SOCKET = INVALID_SOCKET;
+void closeSocket(Socket socket) { closesocket(socket); }
+#else
+typedef int Socket;
+const Socket NO_SOCKET = -1;
+void closeSocket(Socket socket) { close(socket); }
+#endif
+
+const std::string startFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct GameResult {
+	std::vector<double> latenciesMs;
+	int busy = 0;
+	int errors = 0;
+	bool connected = false;
+};
+
+class WebSocketClient {
+	public:
+		~WebSocketClient() { if (this->fd != NO_SOCKET) closeSocket(this->fd); }
+		bool connect(const std::string& host, const std::string& port);
+		bool sendText(const std::string& text);
+		bool receiveText(std::string& text);
+	private:
+		bool sendFrame(int opcode, const std::string& payload);
+		bool readExactly(char* buffer, size_t length);
+
+		Socket fd = NO_SOCKET;
+		std::mt19937 maskGen = std::mt19937(std::random_device()());
+};
+
+bool WebSocketClient::connect(const std::string& host, const std::string& port) {
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) return false;
+	for (addrinfo* address = addresses; address != nullptr && this->fd == NO_SOCKET; address = address->ai_next) {
+		this->fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (this->fd != NO_SOCKET && ::connect(this->fd, address->ai_addr, int(address->ai_addrlen)) != 0) {
+			closeSocket(this->fd);
+			this->fd = NO_SOCKET;
+		}
+	}
+	freeaddrinfo(addresses);
+	if (this->fd == NO_SOCKET) return false;
+
+	//the key only has to be well formed, this client doesn't check the accept hash
+	std::string request = "GET / HTTP/1.1\r\nHost: " + host + ":" + port + "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+		"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+	if (send(this->fd, request.data(), int(request.size()), 0) != int(request.size())) return false;
+
+	std::string response;
+	char c;
+	while (response.size() < 4096 && (response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n") != 0)) {
+		if (!this->readExactly(&c, 1)) return false;
+		response += c;
+	}
+	return response.compare(0, 12, "HTTP/1.1 101") == 0;
+}
+
+bool WebSocketClient::sendText(const std::string& text) {
+	return this->sendFrame(0x1, text);
+}
+
+//client frames must be masked
+bool WebSocketClient::sendFrame(int opcode, const std::string& payload) {
+	std::string frame;
+	frame += char(0x80 | opcode);
+	if (payload.size() < 126) {
+		frame += char(0x80 | payload.size());
+	}
+	else if (payload.size() < 65536) {
+		frame += char(0x80 | 126);
+		frame += char(payload.size() >> 8);
+		frame += char(payload.size() & 0xff);
+	}
+	else {
+		frame += char(0x80 | 127);
+		for (int i = 7; i >= 0; i--) frame += char((uint64_t(payload.size()) >> (8 * i)) & 0xff);
+	}
+	uint32_t mask = this->maskGen();
+	char maskBytes[4];
+	std::memcpy(maskBytes, &mask, 4);
+	frame.append(maskBytes, 4);
+	for (size_t i = 0; i < payload.size(); i++) {
+		frame += char(payload[i] ^ maskBytes[i % 4]);
+	}
+	return send(this->fd, frame.data(), int(frame.size()), 0) == int(frame.size());
+}
+
+bool WebSocketClient::receiveText(std::string& text) {
+	while (true) {
+		unsigned char header[2];
+		if (!this->readExactly(reinterpret_cast<char*>(header), 2)) return false;
+		int opcode = header[0] & 0x0f;
+		uint64_t length = header[1] & 0x7f;
+		if (length >= 126) {
+			unsigned char extended[8];
+			int bytes = length == 126 ? 2 : 8;
+			if (!this->readExactly(reinterpret_cast<char*>(extended), bytes)) return false;
+			length = 0;
+			for (int i = 0; i < bytes; i++) length = (length << 8) | extended[i];
+		}
+		std::string payload(length, '\0');
+		if (length > 0 && !this->readExactly(&payload[0], length)) return false;
+
+		if (opcode == 0x8) return false; //close
+		if (opcode == 0x9) { //ping
+			if (!this->sendFrame(0xa, payload)) return false;
+			continue;
+		}
+		if (opcode == 0x1) {
+			text = payload;
+			return true;
+		}
+	}
+}
+
+bool WebSocketClient::readExactly(char* buffer, size_t length) {
+	while (length > 0) {
+		int received = int(recv(this->fd, buffer, int(length), 0));
+		if (received <= 0) return false;
+		buffer += received;
+		length -= received;
+	}
+	return true;
+}
+
+std::string field(const std::string& message, const std::string& key) {
+	size_t at = message.find("\"" + key + "\":");
+	if (at == std::string::npos) return "";
+	at += key.size() + 3;
+	if (message[at] == '"') return message.substr(at + 1, message.find('"', at + 1) - at - 1);
+	return message.substr(at, message.find_first_of(",}", at) - at);
+}
+
+void playGame(int index, int movesPerGame, int movetimeMs, const std::string& host, const std::string& port, GameResult& result) {
+	WebSocketClient client;
+	if (!client.connect(host, port)) return;
+	result.connected = true;
+
+	chess::Board board = chess::Board(startFen);
+	std::vector<std::string> moves;
+	std::mt19937 gen(index);
+	bool engineIsWhite = index % 2 == 0;
+
+	for (int ply = 0; ply < 2 * movesPerGame; ply++) {
+		chess::Movelist legalMoves;
+		chess::movegen::legalmoves(legalMoves, board);
+		if (legalMoves.empty() || board.isHalfMoveDraw() || board.isRepetition() || board.isInsufficientMaterial()) break;
+
+		chess::Move move;
+		if ((board.sideToMove() == chess::Color::WHITE) == engineIsWhite) {
+			std::string position = "{\"type\":\"position\",\"fen\":\"startpos\",\"moves\":[";
+			for (size_t i = 0; i < moves.size(); i++) position += (i > 0 ? ",\"" : "\"") + moves[i] + "\"";
+			position += "]}";
+			std::string go = "{\"type\":\"go\",\"movetime\":" + std::to_string(movetimeMs) + "}";
+			if (!client.sendText(position)) return;
+
+			//latency is what the player sees, busy retries included
+			std::string reply;
+			auto start = std::chrono::steady_clock::now();
+			while (true) {
+				if (!client.sendText(go) || !client.receiveText(reply)) return;
+				auto end = std::chrono::steady_clock::now();
+
+				std::string type = field(reply, "type");
+				if (type == "busy") {
+					result.busy++;
+					std::string retryAfter = field(reply, "retryAfterMs");
+					std::this_thread::sleep_for(std::chrono::milliseconds(retryAfter.empty() ? 10 : std::stoi(retryAfter)));
+					continue;
+				}
+				if (type != "move") {
+					result.errors++;
+					return;
+				}
+				result.latenciesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+				break;
+			}
+			move = chess::uci::uciToMove(board, field(reply, "move"));
+			if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end()) {
+				result.errors++;
+				return;
+			}
+		}
+		else {
+			move = legalMoves[std::uniform_int_distribution<int>(0, legalMoves.size() - 1)(gen)];
+		}
+		moves.push_back(chess::uci::moveToUci(move));
+		board.makeMove(move);
+	}
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+int main(int argc, char* argv[]) {
+	int games = argc > 1 ? std::stoi(argv[1]) : 16;
+	int movesPerGame = argc > 2 ? std::stoi(argv[2]) : 10;
+	int movetimeMs = argc > 3 ? std::stoi(argv[3]) : 200;
+	std::string host = argc > 4 ? argv[4] : "localhost";
+	std::string port = argc > 5 ? argv[5] : "8080";
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		std::cerr << "could not start Winsock" << std::endl;
+		return 1;
+	}
+#endif
+
+	std::vector<GameResult> results(games);
+	std::vector<std::thread> players;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < games; i++) {
+		players.emplace_back(playGame, i, movesPerGame, movetimeMs, host, port, std::ref(results[i]));
+	}
+	for (std::thread& player : players) {
+		player.join();
+	}
+	std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+	std::vector<double> latencies;
+	int connected = 0, busy = 0, errors = 0;
+	for (const GameResult& result : results) {
+		latencies.insert(latencies.end(), result.latenciesMs.begin(), result.latenciesMs.end());
+		connected += result.connected;
+		busy += result.busy;
+		errors += result.errors;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "games            : " << games << " (" << connected << " connected)" << std::endl;
+	std::cout << "engine moves     : " << latencies.size() << " at movetime " << movetimeMs << " ms" << std::endl;
+	std::cout << "moves/s          : " << (duration.count() > 0 ? latencies.size() / duration.count() : 0) << std::endl;
+	std::cout << "latency p50 (ms) : " << percentile(latencies, 0.50) << std::endl;
+	std::cout << "latency p90 (ms) : " << percentile(latencies, 0.90) << std::endl;
+	std::cout << "latency p99 (ms) : " << percentile(latencies, 0.99) << std::endl;
+	std::cout << "latency max (ms) : " << (latencies.empty() ? 0 : latencies.back()) << std::endl;
+	std::cout << "busy replies     : " << busy << std::endl;
+	std::cout << "errors           : " << errors << std::endl;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return errors > 0 || connected < games ? 1 : 0;
+}
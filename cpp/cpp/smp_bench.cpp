@@ -0,0 +1,60 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include "chess.hpp"
+#include "ChessEngine.h"
+
+//Lazy SMP scaling benchmark: searches a fixed set of positions to the same depth with 1, 2, 4, ... threads
+//and prints nodes/s and time-to-depth for each thread count.
+//
+//usage: smp_bench [depth] [beamWidth] [maxThreads] [hashSizeMB]
+
+const std::vector<std::string> benchPositions = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+	"2r3k1/pp3ppp/2n1b3/3p4/3P4/2PB1N2/P4PPP/4R1K1 b - - 0 22",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+int main(int argc, char* argv[]) {
+	int depth = argc > 1 ? std::stoi(argv[1]) : 5;
+	int beamWidth = argc > 2 ? std::stoi(argv[2]) : 12;
+	int maxThreads = argc > 3 ? std::stoi(argv[3]) : int(std::max(1u, std::thread::hardware_concurrency()));
+	int hashSizeMB = argc > 4 ? std::stoi(argv[4]) : 64;
+
+	std::cout << "depth " << depth << ", beam width " << beamWidth << ", hash " << hashSizeMB << " MB, "
+		<< benchPositions.size() << " positions" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "nodes" << std::setw(12) << "time (s)"
+		<< std::setw(14) << "nodes/s" << std::setw(10) << "speedup" << std::endl;
+
+	double singleThreadTime = 0;
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		uint64_t totalNodes = 0;
+		double totalTime = 0;
+		for (const std::string& fen : benchPositions) {
+			//a fresh engine per position so every thread count starts from an empty table
+			chess::Board board = chess::Board(fen);
+			ChessEngine engine(&board, depth, beamWidth, threads, hashSizeMB);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			engine.getBestMove();
+			auto end = std::chrono::high_resolution_clock::now();
+			std::chrono::duration<double> duration = end - start;
+
+			totalNodes += engine.getNodes();
+			totalTime += duration.count();
+		}
+		if (threads == 1) singleThreadTime = totalTime;
+
+		std::cout << std::setw(8) << threads << std::setw(14) << totalNodes
+			<< std::setw(12) << std::fixed << std::setprecision(3) << totalTime
+			<< std::setw(14) << std::setprecision(0) << (totalTime > 0 ? totalNodes / totalTime : 0)
+			<< std::setw(10) << std::setprecision(2) << (totalTime > 0 ? singleThreadTime / totalTime : 0)
+			<< std::endl;
+	}
+	return 0;
+}
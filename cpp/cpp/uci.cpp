@@ -0,0 +1,274 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include "chess.hpp"
+#include "ChessEngine.h"
+
+//Headless UCI front end for tournament managers and analysis servers. The main thread only reads commands,
+//so stop and isready are answered while a search runs; each go starts the search on a worker thread, which
+//streams an info line per finished iteration and prints bestmove when it is done.
+//
+//usage: uci    (then speak UCI on stdin/stdout)
+
+const std::string startFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+const int DEFAULT_BEAM_WIDTH = 12;
+const int MOVE_OVERHEAD_MS = 50; //kept back from the clock for the GUI and the pipe
+const int DEFAULT_MOVES_TO_GO = 30;
+
+std::mutex outputMutex;
+
+//info lines come from the search thread and replies from the reader, so every line goes out whole
+void send(const std::string& line) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	std::cout << line << std::endl;
+}
+
+struct UciState {
+	chess::Board board = chess::Board(startFen);
+	std::unique_ptr<ChessEngine> engine;
+	int threads = 1;
+	int hashSizeMB = 16;
+	int beamWidth = DEFAULT_BEAM_WIDTH;
+	int multiPv = 1;
+	bool useNnue = false;
+	EvalNoise evalNoise = NOISE_HASHED;
+	std::string evalFile;
+	OpeningBook book; //mapped here, not in the engine, so it survives createEngine
+	bool ownBook = false;
+	BookSelection bookSelection = BOOK_WEIGHTED;
+	Bitbase bitbase;
+
+	std::thread searchThread;
+	std::atomic<bool> stop{false};
+	std::atomic<bool> infinite{false};
+};
+
+//engine scores are 1 << 8 per pawn from white's side, UCI wants centipawns from the side to move
+std::string formatScore(Score score, chess::Color sideToMove) {
+	Score relative = sideToMove == chess::Color::WHITE ? score : -score;
+	if (std::abs(relative) >= SCORE_MATE_BOUND) {
+		//a mate scores SCORE_MATE less its distance in plies, UCI counts moves
+		int moves = (SCORE_MATE - std::abs(relative) + 1) / 2;
+		return "mate " + std::to_string(relative > 0 ? moves : -moves);
+	}
+	return "cp " + std::to_string(relative * 100 / 256);
+}
+
+void createEngine(UciState& state) {
+	state.engine = std::make_unique<ChessEngine>(&state.board, MAX_DEPTH, state.beamWidth, state.threads, state.hashSizeMB);
+	if (!state.evalFile.empty() && !state.engine->loadNetwork(state.evalFile)) {
+		send("info string could not load network " + state.evalFile);
+	}
+	if (state.useNnue && !state.engine->setEvalType(NNUE_EVAL)) {
+		send("info string UseNNUE needs a network, set EvalFile first");
+	}
+
+	state.engine->setEvalNoise(state.evalNoise);
+	state.engine->setMultiPv(state.multiPv);
+	state.engine->setOpeningBook(state.ownBook && state.book.isOpen() ? &state.book : nullptr, state.bookSelection);
+	state.engine->setBitbase(&state.bitbase);
+
+	chess::Board* board = &state.board;
+	state.engine->setInfoCallback([board](const SearchInfo& info) {
+		uint64_t ms = info.time.count();
+		std::ostringstream line;
+		line << "info depth " << info.depth << " multipv " << info.multiPv << " score " << formatScore(info.score, board->sideToMove())
+			<< " nodes " << info.nodes << " nps " << (ms > 0 ? info.nodes * 1000 / ms : info.nodes) << " time " << ms << " pv";
+		for (const chess::Move& move : info.pv) {
+			line << " " << chess::uci::moveToUci(move);
+		}
+		send(line.str());
+	});
+}
+
+void waitForSearch(UciState& state) {
+	if (state.searchThread.joinable()) {
+		state.stop = true;
+		state.searchThread.join();
+	}
+}
+
+void setOption(UciState& state, std::istringstream& in) {
+	std::string token, name, value;
+	in >> token; //name
+	while (in >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+	std::getline(in >> std::ws, value);
+
+	if (name == "Hash") {
+		state.hashSizeMB = std::max(1, std::stoi(value));
+		state.engine->setHashSize(state.hashSizeMB);
+	}
+	else if (name == "Threads") {
+		//the search threads are made with the engine
+		state.threads = std::max(1, std::stoi(value));
+		createEngine(state);
+	}
+	else if (name == "BeamWidth") {
+		state.beamWidth = std::max(1, std::stoi(value));
+		createEngine(state);
+	}
+	else if (name == "MultiPV") {
+		state.multiPv = std::max(1, std::stoi(value));
+		state.engine->setMultiPv(state.multiPv);
+	}
+	else if (name == "EvalFile") {
+		state.evalFile = value == "<empty>" ? "" : value;
+		createEngine(state);
+	}
+	else if (name == "UseNNUE") {
+		state.useNnue = value == "true";
+		if (!state.engine->setEvalType(state.useNnue ? NNUE_EVAL : CLASSICAL_EVAL)) {
+			send("info string UseNNUE needs a network, set EvalFile first");
+		}
+	}
+	else if (name == "EvalNoise") {
+		state.evalNoise = value == "off" ? NOISE_OFF : NOISE_HASHED;
+		state.engine->setEvalNoise(state.evalNoise);
+	}
+	else if (name == "OwnBook" || name == "BookFile" || name == "BookSelection") {
+		if (name == "OwnBook") state.ownBook = value == "true";
+		if (name == "BookSelection") state.bookSelection = value == "best" ? BOOK_BEST : BOOK_WEIGHTED;
+		if (name == "BookFile") {
+			if (value == "<empty>") state.book.close();
+			else if (!state.book.open(value)) send("info string could not open book " + value);
+		}
+		state.engine->setOpeningBook(state.ownBook && state.book.isOpen() ? &state.book : nullptr, state.bookSelection);
+	}
+	else if (name == "BitbasePath") {
+		state.bitbase.close();
+		if (value != "<empty>" && !state.bitbase.open(value)) send("info string no bitbases in " + value);
+	}
+	else {
+		send("info string unknown option " + name);
+	}
+}
+
+void setPosition(UciState& state, std::istringstream& in) {
+	std::string token;
+	in >> token;
+	if (token == "startpos") {
+		state.board.setFen(startFen);
+		in >> token; //moves, if any
+	}
+	else if (token == "fen") {
+		std::string fen;
+		while (in >> token && token != "moves") fen += (fen.empty() ? "" : " ") + token;
+		state.board.setFen(fen);
+	}
+
+	while (in >> token) {
+		chess::Move move = chess::uci::uciToMove(state.board, token);
+		if (!state.engine->isLegalMove(move, &state.board)) {
+			send("info string illegal move " + token);
+			break;
+		}
+		state.board.makeMove(move);
+	}
+}
+
+void go(UciState& state, std::istringstream& in) {
+	SearchLimits limits;
+	int64_t wtime = 0, btime = 0, winc = 0, binc = 0, movestogo = 0, movetime = 0;
+	bool infinite = false;
+
+	std::string token;
+	while (in >> token) {
+		if (token == "depth") in >> limits.depth;
+		else if (token == "nodes") in >> limits.nodes;
+		else if (token == "movetime") in >> movetime;
+		else if (token == "wtime") in >> wtime;
+		else if (token == "btime") in >> btime;
+		else if (token == "winc") in >> winc;
+		else if (token == "binc") in >> binc;
+		else if (token == "movestogo") in >> movestogo;
+		else if (token == "infinite") infinite = true;
+	}
+
+	bool white = state.board.sideToMove() == chess::Color::WHITE;
+	int64_t time = white ? wtime : btime;
+	int64_t increment = white ? winc : binc;
+	int64_t budgetMs = 0;
+	if (movetime > 0) {
+		budgetMs = std::max<int64_t>(1, movetime - MOVE_OVERHEAD_MS);
+	}
+	else if (time > 0) {
+		//an even share of what's left plus most of the increment, never more than is actually on the clock
+		budgetMs = time / (movestogo > 0 ? movestogo : DEFAULT_MOVES_TO_GO) + increment * 3 / 4;
+		budgetMs = std::max<int64_t>(1, std::min(budgetMs, time - MOVE_OVERHEAD_MS));
+	}
+	if (budgetMs > 0 && !infinite) {
+		limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+	}
+
+	state.stop = false;
+	state.infinite = infinite;
+	limits.stop = &state.stop;
+	state.searchThread = std::thread([&state, limits]() {
+		chess::Move best = state.engine->getBestMove(limits);
+		//under go infinite the answer may only be given once the GUI says stop, even if the search ran out of depth
+		while (state.infinite && !state.stop) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		send("bestmove " + (best == chess::Move(chess::Move::NO_MOVE) ? std::string("0000") : chess::uci::moveToUci(best)));
+	});
+}
+
+int main() {
+	UciState state;
+	createEngine(state);
+
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		std::istringstream in(line);
+		std::string command;
+		in >> command;
+
+		if (command == "uci") {
+			send("id name ChessEngine");
+			send("id author ChessEngine developers");
+			send("option name Hash type spin default 16 min 1 max 65536");
+			send("option name Threads type spin default 1 min 1 max 256");
+			send("option name BeamWidth type spin default " + std::to_string(DEFAULT_BEAM_WIDTH) + " min 1 max 256");
+			send("option name MultiPV type spin default 1 min 1 max 256");
+			send("option name EvalFile type string default <empty>");
+			send("option name UseNNUE type check default false");
+			send("option name EvalNoise type combo default hashed var hashed var off");
+			send("option name OwnBook type check default false");
+			send("option name BookFile type string default <empty>");
+			send("option name BookSelection type combo default weighted var weighted var best");
+			send("option name BitbasePath type string default <empty>");
+			send("uciok");
+		}
+		else if (command == "isready") {
+			send("readyok");
+		}
+		else if (command == "stop") {
+			waitForSearch(state);
+		}
+		else if (command == "quit") {
+			break;
+		}
+		else if (command == "ucinewgame" || command == "setoption" || command == "position" || command == "go") {
+			//these change the engine or the board, which a running search is still using
+			waitForSearch(state);
+			if (command == "ucinewgame") {
+				//noise is fixed within a game so the hash stays sound across moves, and differs between games
+				state.engine->clearHash();
+				state.engine->setSeed(std::random_device()());
+			}
+			else if (command == "setoption") setOption(state, in);
+			else if (command == "position") setPosition(state, in);
+			else go(state, in);
+		}
+	}
+
+	waitForSearch(state);
+	return 0;
+}